@@ -0,0 +1,471 @@
+#include "archive.h"
+#include "compression.h"
+#include "checksum.h"
+#include "parallel.h"
+#include "utils.h"
+
+#include <atomic>
+#include <map>
+#include <set>
+
+using namespace std;
+
+// ==================== Record Parsing ====================
+
+// Parses a whole-number id, ignoring surrounding whitespace
+static bool parseId(const string &xml, size_t begin, size_t end, int &id)
+{
+    while (begin < end && isspace((unsigned char)xml[begin])) begin++;
+    while (end > begin && isspace((unsigned char)xml[end - 1])) end--;
+    if (begin == end)
+        return false;
+
+    size_t i = begin;
+    if (xml[i] == '-') i++;
+    if (i == end)
+        return false;
+    for (; i < end; ++i)
+    {
+        if (!isdigit((unsigned char)xml[i]))
+            return false;
+    }
+
+    id = stoi(xml.substr(begin, end - begin));
+    return true;
+}
+
+// Reads the user id and follower ids of the <user> record in [begin, end).
+// Followers may be written as <follower><id>X</id></follower> or <follower>X</follower>.
+static bool parseUserRecord(const string &xml, size_t begin, size_t end, int &id, vector<int> &followers)
+{
+    followers.clear();
+
+    size_t followersStart = xml.find("<followers>", begin);
+    if (followersStart > end)
+        followersStart = end;
+
+    // The user's own id is the first <id> outside the followers list
+    size_t idStart = xml.find("<id>", begin);
+    if (idStart == string::npos || idStart >= followersStart)
+        return false;
+    size_t idEnd = xml.find("</id>", idStart);
+    if (idEnd == string::npos || idEnd > end || !parseId(xml, idStart + 4, idEnd, id))
+        return false;
+
+    size_t followersEnd = xml.find("</followers>", followersStart);
+    if (followersStart == end || followersEnd == string::npos || followersEnd > end)
+        return true;
+
+    size_t fpos = followersStart;
+    while ((fpos = xml.find("<follower>", fpos)) != string::npos && fpos < followersEnd)
+    {
+        size_t fStart = fpos + 10;
+        size_t fEnd = xml.find("</follower>", fStart);
+        if (fEnd == string::npos || fEnd > followersEnd)
+            break;
+
+        size_t nestedId = xml.find("<id>", fStart);
+        int followerId;
+        if (nestedId != string::npos && nestedId < fEnd)
+        {
+            size_t nestedEnd = xml.find("</id>", nestedId);
+            if (nestedEnd != string::npos && nestedEnd < fEnd && parseId(xml, nestedId + 4, nestedEnd, followerId))
+                followers.push_back(followerId);
+        }
+        else if (parseId(xml, fStart, fEnd, followerId))
+        {
+            followers.push_back(followerId);
+        }
+
+        fpos = fEnd + 11;
+    }
+
+    return true;
+}
+
+// ==================== Archive Writing ====================
+
+string buildArchive(const string &xml)
+{
+    vector<ArchiveBlock> blocks;
+    string blockData;
+    map<int, ArchiveEntry> index; // ordered so the same input gives the same file
+
+    size_t blockStart = 0;
+    auto flushBlock = [&](size_t end)
+    {
+        string compressed = encodeBPEStream(xml.substr(blockStart, end - blockStart));
+        blocks.push_back({ARCHIVE_HEADER_SIZE + blockData.size(), (uint32_t)compressed.size(), (uint32_t)(end - blockStart),
+                          crc32c(compressed.data(), compressed.size())});
+        blockData += compressed;
+        blockStart = end;
+    };
+
+    // 1. Cut the document into blocks at </user> boundaries, indexing each record
+    size_t pos = 0;
+    vector<int> followers;
+    while ((pos = xml.find("<user>", pos)) != string::npos)
+    {
+        size_t end = xml.find("</user>", pos);
+        if (end == string::npos)
+            break;
+        end += 7;
+
+        int userId;
+        if (parseUserRecord(xml, pos, end, userId, followers))
+        {
+            ArchiveEntry &entry = index[userId];
+            entry.block = (uint32_t)blocks.size();
+            entry.offset = (uint32_t)(pos - blockStart);
+            entry.length = (uint32_t)(end - pos);
+
+            for (int follower : followers)
+                index[follower].following.push_back(userId);
+        }
+
+        pos = end;
+        if (end - blockStart >= ARCHIVE_BLOCK_SIZE)
+            flushBlock(end);
+    }
+
+    // Whatever follows the last record (e.g. </users>)
+    if (blockStart < xml.size() || blocks.empty())
+        flushBlock(xml.size());
+
+    // 2. Index: block table, then one entry per user id
+    string indexData;
+    for (const auto &block : blocks)
+    {
+        putU64(indexData, block.fileOffset);
+        putU32(indexData, block.compressedSize);
+        putU32(indexData, block.rawSize);
+        putU32(indexData, block.checksum);
+    }
+
+    for (auto &[userId, entry] : index)
+    {
+        sort(entry.following.begin(), entry.following.end());
+        entry.following.erase(unique(entry.following.begin(), entry.following.end()), entry.following.end());
+
+        putU32(indexData, (uint32_t)userId);
+        putU32(indexData, entry.block);
+        putU32(indexData, entry.offset);
+        putU32(indexData, entry.length);
+        putU32(indexData, (uint32_t)entry.following.size());
+        for (int followed : entry.following)
+            putU32(indexData, (uint32_t)followed);
+    }
+
+    // 3. Header
+    string result(ARCHIVE_MAGIC, 4);
+    putU32(result, ARCHIVE_VERSION);
+    putU32(result, (uint32_t)blocks.size());
+    putU32(result, (uint32_t)index.size());
+    putU64(result, ARCHIVE_HEADER_SIZE + blockData.size());
+    putU64(result, xml.size());
+
+    result += blockData;
+    result += indexData;
+
+    cout << "Archive complete. " << index.size() << " users in " << blocks.size()
+         << " blocks, Original size: " << xml.size() << " bytes, Archive size: "
+         << result.size() << " bytes" << endl;
+
+    return result;
+}
+
+// ==================== Archive Reading ====================
+
+bool isArchiveFile(const string &path)
+{
+    ifstream file(path, ios::binary);
+    char magic[4];
+    return file.read(magic, 4) && memcmp(magic, ARCHIVE_MAGIC, 4) == 0;
+}
+
+// Reads the block table from an index buffer, returns the first byte after it
+static const unsigned char *parseBlockTable(const unsigned char *p, const unsigned char *end,
+                                            uint32_t blockCount, vector<ArchiveBlock> &blocks)
+{
+    const size_t entrySize = 20;
+    if ((size_t)(end - p) < (size_t)blockCount * entrySize)
+        return nullptr;
+
+    blocks.resize(blockCount);
+    for (uint32_t b = 0; b < blockCount; ++b, p += entrySize)
+        blocks[b] = {getU64(p), getU32(p + 8), getU32(p + 12), getU32(p + 16)};
+
+    return p;
+}
+
+bool verifyArchiveBlock(const ArchiveBlock &block, const unsigned char *data, uint32_t index)
+{
+    if (crc32c(data, block.compressedSize) == block.checksum)
+        return true;
+
+    cerr << "Error: Checksum mismatch in archive block " << index << "; the file is damaged" << endl;
+    return false;
+}
+
+// Validates the header and reads the block table of an archive held in memory
+bool parseArchive(const string &archive, vector<ArchiveBlock> &blocks)
+{
+    const unsigned char *bytes = (const unsigned char *)archive.data();
+    if (archive.size() < ARCHIVE_HEADER_SIZE || getU32(bytes + 4) != ARCHIVE_VERSION)
+    {
+        cerr << "Error: Unsupported archive version" << endl;
+        return false;
+    }
+
+    uint64_t indexOffset = getU64(bytes + 16);
+    if (indexOffset > archive.size() ||
+        !parseBlockTable(bytes + indexOffset, bytes + archive.size(), getU32(bytes + 8), blocks))
+    {
+        cerr << "Error: Corrupt archive index" << endl;
+        return false;
+    }
+
+    for (const auto &block : blocks)
+    {
+        if (block.fileOffset + block.compressedSize > indexOffset)
+        {
+            cerr << "Error: Corrupt archive block table" << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool decodeArchiveBlock(const string &archive, const vector<ArchiveBlock> &blocks, uint32_t index, string &text)
+{
+    const ArchiveBlock &block = blocks[index];
+    const unsigned char *data = (const unsigned char *)archive.data() + block.fileOffset;
+    if (!verifyArchiveBlock(block, data, index))
+        return false;
+
+    BPEStream stream;
+    BPEExpansionTable table;
+    if (!parseBPEStream(data, block.compressedSize, stream) || !buildExpansionTable(stream, table) ||
+        !expandBPEStream(stream, table, text) || text.size() != block.rawSize)
+    {
+        cerr << "Error: Corrupt archive block" << endl;
+        return false;
+    }
+    return true;
+}
+
+string decompressArchive(const string &archive)
+{
+    vector<ArchiveBlock> blocks;
+    if (!parseArchive(archive, blocks))
+        return "";
+
+    string output;
+    output.reserve(getU64((const unsigned char *)archive.data() + 24));
+    for (uint32_t b = 0; b < blocks.size(); ++b)
+    {
+        string text;
+        if (!decodeArchiveBlock(archive, blocks, b, text))
+            return "";
+        output += text;
+    }
+
+    return output;
+}
+
+bool decompressArchiveToFile(const string &archive, const string &outputPath, int threads)
+{
+    vector<ArchiveBlock> blocks;
+    if (!parseArchive(archive, blocks))
+        return false;
+
+    // Raw block sizes are stored, so output offsets are a plain prefix sum
+    vector<uint64_t> blockOffset(blocks.size() + 1, 0);
+    for (size_t b = 0; b < blocks.size(); ++b)
+        blockOffset[b + 1] = blockOffset[b] + blocks[b].rawSize;
+
+    MappedOutputFile output;
+    if (!output.open(outputPath, (size_t)blockOffset.back()))
+        return false;
+
+    // Any worker may report a damaged block, so the flag is atomic
+    atomic<bool> ok(true);
+    char *out = output.data();
+    parallelFor(blocks.size(), threads, [&](size_t begin, size_t end, int)
+    {
+        string text;
+        for (size_t b = begin; b < end && ok; ++b)
+        {
+            if (!decodeArchiveBlock(archive, blocks, (uint32_t)b, text))
+            {
+                ok = false;
+                return;
+            }
+            memcpy(out + blockOffset[b], text.data(), text.size());
+        }
+    });
+
+    if (!output.close() || !ok)
+        return false;
+
+    cout << "Decompressed " << blocks.size() << " archive blocks, output size is "
+         << blockOffset.back() << " bytes." << endl;
+    return true;
+}
+
+bool ArchiveReader::open(const string &path)
+{
+    archive_File.open(path, ios::binary | ios::ate);
+    if (!archive_File.is_open())
+    {
+        cerr << "Error: Could not open archive: " << path << endl;
+        return false;
+    }
+    uint64_t fileSize = (uint64_t)archive_File.tellg();
+
+    unsigned char header[ARCHIVE_HEADER_SIZE];
+    archive_File.seekg(0);
+    if (!archive_File.read((char *)header, ARCHIVE_HEADER_SIZE) ||
+        memcmp(header, ARCHIVE_MAGIC, 4) != 0 || getU32(header + 4) != ARCHIVE_VERSION)
+    {
+        cerr << "Error: Not a supported archive: " << path << endl;
+        return false;
+    }
+
+    uint32_t blockCount = getU32(header + 8);
+    uint32_t entryCount = getU32(header + 12);
+    uint64_t indexOffset = getU64(header + 16);
+    if (indexOffset > fileSize)
+    {
+        cerr << "Error: Corrupt archive index" << endl;
+        return false;
+    }
+
+    // Only the index is read up front
+    string indexData(fileSize - indexOffset, '\0');
+    archive_File.seekg(indexOffset);
+    archive_File.read(&indexData[0], indexData.size());
+
+    const unsigned char *p = (const unsigned char *)indexData.data();
+    const unsigned char *end = p + indexData.size();
+    p = parseBlockTable(p, end, blockCount, archive_Blocks);
+
+    for (uint32_t e = 0; p && e < entryCount; ++e)
+    {
+        if (end - p < 20)
+        {
+            p = nullptr;
+            break;
+        }
+
+        int userId = (int)getU32(p);
+        ArchiveEntry &entry = archive_Index[userId];
+        entry.block = getU32(p + 4);
+        entry.offset = getU32(p + 8);
+        entry.length = getU32(p + 12);
+        uint32_t followingCount = getU32(p + 16);
+        p += 20;
+
+        if ((size_t)(end - p) < (size_t)followingCount * 4)
+        {
+            p = nullptr;
+            break;
+        }
+        entry.following.resize(followingCount);
+        for (uint32_t f = 0; f < followingCount; ++f, p += 4)
+            entry.following[f] = (int)getU32(p);
+    }
+
+    if (!p)
+    {
+        cerr << "Error: Corrupt archive index" << endl;
+        return false;
+    }
+
+    cout << "Archive index loaded: " << archive_Index.size() << " users in "
+         << archive_Blocks.size() << " blocks" << endl;
+    return true;
+}
+
+bool ArchiveReader::loadBlock(uint32_t block, const string *&text)
+{
+    auto cached = block_Cache.find(block);
+    if (cached != block_Cache.end())
+    {
+        text = &cached->second;
+        return true;
+    }
+
+    if (block >= archive_Blocks.size())
+        return false;
+
+    const ArchiveBlock &info = archive_Blocks[block];
+    string compressed(info.compressedSize, '\0');
+    archive_File.clear();
+    archive_File.seekg(info.fileOffset);
+    if (!archive_File.read(&compressed[0], compressed.size()))
+    {
+        cerr << "Error: Failed to read archive block " << block << endl;
+        return false;
+    }
+    if (!verifyArchiveBlock(info, (const unsigned char *)compressed.data(), block))
+        return false;
+
+    string &decoded = block_Cache[block];
+    if (!decodeBPEStream(compressed, decoded) || decoded.size() != info.rawSize)
+    {
+        cerr << "Error: Corrupt archive block " << block << endl;
+        block_Cache.erase(block);
+        return false;
+    }
+
+    text = &decoded;
+    return true;
+}
+
+bool ArchiveReader::extractUser(int userId, string &record)
+{
+    auto it = archive_Index.find(userId);
+    if (it == archive_Index.end() || it->second.block == ARCHIVE_NO_RECORD)
+        return false;
+
+    const ArchiveEntry &entry = it->second;
+    const string *text;
+    if (!loadBlock(entry.block, text) || (uint64_t)entry.offset + entry.length > text->size())
+        return false;
+
+    record = text->substr(entry.offset, entry.length);
+    return true;
+}
+
+string ArchiveReader::usersDocument(const vector<int> &ids)
+{
+    string document = "<users>\n";
+    string record;
+    for (int userId : ids)
+    {
+        if (extractUser(userId, record))
+            document += record + "\n";
+    }
+    document += "</users>\n";
+    return document;
+}
+
+string ArchiveReader::suggestDocument(int userId)
+{
+    set<int> needed;
+    auto it = archive_Index.find(userId);
+    if (it != archive_Index.end())
+    {
+        for (int friendId : it->second.following)
+        {
+            needed.insert(friendId);
+
+            auto friendEntry = archive_Index.find(friendId);
+            if (friendEntry != archive_Index.end())
+                needed.insert(friendEntry->second.following.begin(), friendEntry->second.following.end());
+        }
+    }
+
+    return usersDocument(vector<int>(needed.begin(), needed.end()));
+}
@@ -0,0 +1,86 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <unordered_map>
+#include <cstdint>
+
+using namespace std;
+
+// Seekable archive (.xarc): the document is split into BPE-compressed blocks
+// at </user> boundaries, followed by an index that maps every user id to the
+// block and offset holding its <user> record.
+//
+// Layout (all fields little-endian):
+//   header : "XARC", u32 version, u32 block count, u32 entry count,
+//            u64 index offset, u64 original size
+//   blocks : one BPE stream per block, back to back
+//   index  : block count x {u64 file offset, u32 compressed size, u32 raw size,
+//                           u32 CRC32C of the compressed block}
+//            entry count x {i32 id, u32 block, u32 offset, u32 length,
+//                           u32 following count, i32 following ids...}
+// Only the current version is read; every block is checked against its CRC.
+const char ARCHIVE_MAGIC[4] = {'X', 'A', 'R', 'C'};
+const uint32_t ARCHIVE_VERSION = 2;
+const size_t ARCHIVE_HEADER_SIZE = 32;
+const size_t ARCHIVE_BLOCK_SIZE = 256 * 1024;
+
+// Block value of users that only appear as followers
+const uint32_t ARCHIVE_NO_RECORD = 0xFFFFFFFF;
+
+struct ArchiveBlock
+{
+    uint64_t fileOffset;
+    uint32_t compressedSize;
+    uint32_t rawSize;
+    uint32_t checksum;
+};
+
+struct ArchiveEntry
+{
+    uint32_t block = ARCHIVE_NO_RECORD;
+    uint32_t offset = 0;
+    uint32_t length = 0;
+    vector<int> following; // users whose <followers> list this user
+};
+
+// Builds the whole archive file content from an XML document
+string buildArchive(const string &xml);
+
+// Expands every block back into the original document
+string decompressArchive(const string &archive);
+bool decompressArchiveToFile(const string &archive, const string &outputPath, int threads);
+
+bool isArchiveFile(const string &path);
+
+// Validates the header and reads the block table of an archive held in memory
+bool parseArchive(const string &archive, vector<ArchiveBlock> &blocks);
+
+// Checks the compressed bytes of block index against its CRC
+bool verifyArchiveBlock(const ArchiveBlock &block, const unsigned char *data, uint32_t index);
+
+// Reads the index once, then only the blocks a query needs
+class ArchiveReader {
+private:
+    ifstream archive_File;
+    vector<ArchiveBlock> archive_Blocks;
+    unordered_map<int, ArchiveEntry> archive_Index;
+    unordered_map<uint32_t, string> block_Cache;
+
+    bool loadBlock(uint32_t block, const string *&text);
+
+public:
+    bool open(const string &path);
+    bool extractUser(int userId, string &record);
+
+    // <users> document holding the records of the given users only
+    string usersDocument(const vector<int> &ids);
+
+    // Every record suggest() reads for userId: the users it follows and the
+    // users those follow
+    string suggestDocument(int userId);
+};
+
+#endif
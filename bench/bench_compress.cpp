@@ -0,0 +1,294 @@
+// Compression benchmark: runs compress() and decompress() over synthetic and
+// real-shaped social-network documents and reports ratio, MB/s and peak RSS
+// for every mode, level and thread count.
+//
+// Usage: bench_compress [-i sample.xml] [-o output/bench_compress] [-s 65536,1048576] [-j 1,4]
+// Writes <prefix>.csv and <prefix>.json and prints the CSV rows.
+
+#include "functions.h"
+#include "compression.h"
+#include "entropy.h"
+#include "parallel.h"
+#include "utils.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+struct BenchCase
+{
+    string corpus;
+    size_t size;
+    string mode;
+    int level;
+    int threads;
+};
+
+struct BenchResult
+{
+    size_t inputSize = 0;
+    size_t compressedSize = 0;
+    double compressMBs = 0;
+    double decompressMBs = 0;
+    long peakRssKB = -1;
+    bool roundTrip = false;
+};
+
+// Every measurement is repeated until it has run this long, then averaged
+const double BENCH_MIN_SECONDS = 0.2;
+
+// ==================== Corpus ====================
+
+// Users with posts, topics and followers, laid out like input_file.xml.
+// Words are drawn with a skewed distribution so common ones repeat like real text.
+static string syntheticDocument(size_t size)
+{
+    static const vector<string> words = {
+        "the", "data", "hello", "world", "coding", "graph", "network", "music", "sports",
+        "science", "learning", "today", "great", "weather", "love", "new", "project",
+        "team", "game", "friends", "travel", "photo", "release", "update", "question",
+        "thanks", "everyone", "weekend", "coffee", "book", "morning", "city", "market"};
+    static const vector<string> topics = {
+        "programming", "tech", "education", "weather", "sports", "music", "economy", "travel"};
+    static const vector<string> names = {
+        "Alice", "Bob", "Charlie", "Diana", "Ethan", "Fatma", "Omar", "Mona", "Youssef", "Sara"};
+
+    mt19937 rng(12345);
+    geometric_distribution<int> wordPick(0.15);
+    size_t users = size / 1200 + 1;
+
+    string xml = "<users>\n";
+    for (size_t id = 1; xml.size() < size; ++id)
+    {
+        xml += "    <user>\n        <id>" + to_string(id) + "</id>\n";
+        xml += "        <name>" + names[rng() % names.size()] + "</name>\n        <posts>\n";
+        for (int p = 1 + rng() % 4; p > 0; --p)
+        {
+            xml += "            <post>\n                <body>";
+            for (int w = 4 + rng() % 12; w > 0; --w)
+            {
+                xml += words[min<size_t>(wordPick(rng), words.size() - 1)];
+                xml += w > 1 ? " " : ".";
+            }
+            xml += "</body>\n                <topics>\n";
+            for (int t = 1 + rng() % 2; t > 0; --t)
+                xml += "                    <topic>" + topics[rng() % topics.size()] + "</topic>\n";
+            xml += "                </topics>\n            </post>\n";
+        }
+        xml += "        </posts>\n        <followers>\n";
+        for (int f = rng() % 6; f > 0; --f)
+            xml += "            <follower>\n                <id>" + to_string(1 + rng() % users) +
+                   "</id>\n            </follower>\n";
+        xml += "        </followers>\n    </user>\n";
+    }
+    xml += "</users>\n";
+    return xml;
+}
+
+// The users of a real sample repeated until the document reaches the size
+static string tiledDocument(const string &sample, size_t size)
+{
+    size_t first = sample.find("<user>");
+    size_t last = sample.rfind("</user>");
+    if (first == string::npos || last == string::npos)
+        return "";
+
+    size_t lineStart = sample.rfind('\n', first);
+    lineStart = lineStart == string::npos ? 0 : lineStart + 1;
+    string users = sample.substr(lineStart, last + 7 - lineStart) + "\n";
+
+    string xml = sample.substr(0, lineStart);
+    while (xml.size() < size)
+        xml += users;
+    xml += sample.substr(last + 7 + (sample[last + 7] == '\n' ? 1 : 0));
+    return xml;
+}
+
+// ==================== Measurement ====================
+
+template <typename Body>
+static double secondsPerRun(Body body)
+{
+    auto start = chrono::steady_clock::now();
+    double elapsed = 0;
+    int runs = 0;
+    do
+    {
+        body();
+        runs++;
+        elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    } while (elapsed < BENCH_MIN_SECONDS);
+    return elapsed / runs;
+}
+
+static BenchResult runCase(const BenchCase &c, const string &sample, const string &scratchPath)
+{
+    BenchResult result;
+    string xml = c.corpus == "synthetic" ? syntheticDocument(c.size) : tiledDocument(sample, c.size);
+
+    // compress() and decompress() report progress on cout
+    streambuf *console = cout.rdbuf(nullptr);
+
+    string comp;
+    double compressSeconds = secondsPerRun([&] { comp = compress(xml, c.mode, c.threads, c.level); });
+
+    string restored;
+    double decompressSeconds;
+    if (c.threads == 1)
+    {
+        decompressSeconds = secondsPerRun([&] { restored = decompress(comp); });
+    }
+    else
+    {
+        decompressSeconds = secondsPerRun([&] { decompressToFile(comp, scratchPath, c.threads); });
+        extract_binary_content(scratchPath, restored);
+        remove(scratchPath.c_str());
+    }
+
+    cout.clear();
+    cout.rdbuf(console);
+
+    result.inputSize = xml.size();
+    result.compressedSize = comp.size();
+    result.compressMBs = xml.size() / 1e6 / compressSeconds;
+    result.decompressMBs = xml.size() / 1e6 / decompressSeconds;
+    result.roundTrip = !comp.empty() && restored == xml;
+
+#ifndef _WIN32
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    result.peakRssKB = usage.ru_maxrss;
+#endif
+    return result;
+}
+
+// Each case runs in its own process so its peak RSS is not hidden by an earlier, bigger one
+static BenchResult measure(const BenchCase &c, const string &sample, const string &scratchPath)
+{
+#ifdef _WIN32
+    return runCase(c, sample, scratchPath);
+#else
+    int fds[2];
+    if (pipe(fds) != 0)
+        return runCase(c, sample, scratchPath);
+
+    pid_t child = fork();
+    if (child == 0)
+    {
+        close(fds[0]);
+        BenchResult result = runCase(c, sample, scratchPath);
+        ssize_t written = write(fds[1], &result, sizeof(result));
+        _exit(written == (ssize_t)sizeof(result) ? 0 : 1);
+    }
+
+    close(fds[1]);
+    BenchResult result;
+    if (child < 0 || read(fds[0], &result, sizeof(result)) != (ssize_t)sizeof(result))
+        cerr << "Error: Benchmark case " << c.corpus << "/" << c.mode << " did not finish" << endl;
+    close(fds[0]);
+    if (child > 0)
+        waitpid(child, nullptr, 0);
+    return result;
+#endif
+}
+
+// ==================== Report ====================
+
+static vector<size_t> parseList(const string &text)
+{
+    vector<size_t> values;
+    stringstream stream(text);
+    string item;
+    while (getline(stream, item, ','))
+    {
+        if (!item.empty())
+            values.push_back(stoull(item));
+    }
+    return values;
+}
+
+int main(int argc, char *argv[])
+{
+    string samplePath = "input_file.xml";
+    string prefix = "output/bench_compress";
+    vector<size_t> sizes = {64 << 10, 1 << 20, 4 << 20};
+    vector<size_t> threadCounts = {1};
+    if (resolveThreadCount(0) > 1)
+        threadCounts.push_back(resolveThreadCount(0));
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        string arg = argv[i];
+        if (arg == "-i")
+            samplePath = argv[i + 1];
+        else if (arg == "-o")
+            prefix = argv[i + 1];
+        else if (arg == "-s")
+            sizes = parseList(argv[i + 1]);
+        else if (arg == "-j")
+            threadCounts = parseList(argv[i + 1]);
+    }
+
+    string sample;
+    vector<string> corpora = {"synthetic"};
+    if (extract_binary_content(samplePath, sample) && !tiledDocument(sample, 1).empty())
+        corpora.push_back("tiled");
+    else
+        cerr << "Skipping the tiled corpus: " << samplePath << " has no <user> elements" << endl;
+
+    vector<BenchCase> cases;
+    for (const string &corpus : corpora)
+        for (size_t size : sizes)
+            for (const char *mode : {"bpe", "wide", "xml"})
+                for (int level : {COMPRESSION_LEVEL_DICTIONARY, COMPRESSION_LEVEL_ENTROPY})
+                    for (size_t threads : threadCounts)
+                        cases.push_back({corpus, size, mode, level, (int)threads});
+
+    string header = "corpus,size_bytes,mode,level,threads,compressed_bytes,ratio,"
+                    "compress_mb_s,decompress_mb_s,peak_rss_kb,round_trip";
+    string csv = header + "\n";
+    string json = "[\n";
+    cout << header << endl;
+
+    for (size_t i = 0; i < cases.size(); ++i)
+    {
+        const BenchCase &c = cases[i];
+        BenchResult r = measure(c, sample, prefix + ".scratch");
+        double ratio = r.compressedSize ? (double)r.inputSize / r.compressedSize : 0;
+
+        char row[256];
+        snprintf(row, sizeof(row), "%s,%zu,%s,%d,%d,%zu,%.2f,%.1f,%.1f,%ld,%s", c.corpus.c_str(),
+                 r.inputSize, c.mode.c_str(), c.level, c.threads, r.compressedSize, ratio, r.compressMBs,
+                 r.decompressMBs, r.peakRssKB, r.roundTrip ? "ok" : "FAIL");
+        cout << row << endl;
+        csv += string(row) + "\n";
+
+        char object[512];
+        snprintf(object, sizeof(object),
+                 "  {\"corpus\": \"%s\", \"size_bytes\": %zu, \"mode\": \"%s\", \"level\": %d, "
+                 "\"threads\": %d, \"compressed_bytes\": %zu, \"ratio\": %.2f, \"compress_mb_s\": %.1f, "
+                 "\"decompress_mb_s\": %.1f, \"peak_rss_kb\": %ld, \"round_trip\": %s}%s\n",
+                 c.corpus.c_str(), r.inputSize, c.mode.c_str(), c.level, c.threads, r.compressedSize, ratio,
+                 r.compressMBs, r.decompressMBs, r.peakRssKB, r.roundTrip ? "true" : "false",
+                 i + 1 < cases.size() ? "," : "");
+        json += object;
+    }
+    json += "]\n";
+
+    if (!writeToFile(prefix + ".csv", csv) || !writeToFile(prefix + ".json", json))
+        return 1;
+    cout << "Results written to " << prefix << ".csv and " << prefix << ".json" << endl;
+    return 0;
+}
@@ -0,0 +1,197 @@
+// Randomized check of intersectSorted(): random sorted lists, sized so that every
+// step (merge, gallop and bitset) is taken, are intersected over plain and
+// varint-coded lists and compared with a fold of std::set_intersection.
+//
+// Usage: check_intersection [-n rounds] [-s seed]
+// Prints one line per path and exits with status 1 on the first mismatch.
+
+#include "intersection.h"
+#include "compact_graph.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Rounds per path unless -n is given
+const int CHECK_DEFAULT_ROUNDS = 2000;
+
+enum CheckPath
+{
+    CHECK_MERGE,  // lists of similar size
+    CHECK_GALLOP, // each list far longer than the one before
+    CHECK_BITSET, // dense lists over a small universe
+    CHECK_MIXED   // any sizes
+};
+
+// count distinct ids below universe, ascending
+static vector<uint32_t> randomList(mt19937 &rng, size_t universe, size_t count)
+{
+    count = min(count, universe);
+    vector<uint32_t> list;
+    if (count * 2 > universe)
+    {
+        // Dense: keep each id with probability count / universe
+        bernoulli_distribution keep((double)count / universe);
+        for (uint32_t id = 0; id < universe; ++id)
+            if (keep(rng))
+                list.push_back(id);
+        return list;
+    }
+
+    uniform_int_distribution<uint32_t> pick(0, (uint32_t)universe - 1);
+    while (list.size() < count)
+        list.push_back(pick(rng));
+    sort(list.begin(), list.end());
+    list.erase(unique(list.begin(), list.end()), list.end());
+    return list;
+}
+
+static vector<vector<uint32_t>> randomLists(mt19937 &rng, CheckPath path, size_t &universe)
+{
+    size_t listCount = 2 + rng() % 4;
+    vector<vector<uint32_t>> lists;
+
+    switch (path)
+    {
+    case CHECK_MERGE:
+        universe = 100000 + rng() % 100000;
+        for (size_t l = 0; l < listCount; ++l)
+            lists.push_back(randomList(rng, universe, 500 + rng() % 2000));
+        break;
+
+    case CHECK_GALLOP:
+    {
+        universe = 1000000;
+        size_t size = 1 + rng() % 20;
+        for (size_t l = 0; l < listCount; ++l, size *= INTERSECT_GALLOP_RATIO + rng() % 8)
+            lists.push_back(randomList(rng, universe, size));
+        break;
+    }
+
+    case CHECK_BITSET:
+        universe = 64 + rng() % 5000;
+        for (size_t l = 0; l < listCount; ++l)
+            lists.push_back(randomList(rng, universe, universe / (1 + rng() % 4)));
+        break;
+
+    case CHECK_MIXED:
+        universe = 1 + rng() % 20000;
+        for (size_t l = 0; l < listCount; ++l)
+            lists.push_back(randomList(rng, universe, rng() % (universe + 1)));
+        break;
+    }
+
+    // Shared ids, so the intersections are not all empty
+    vector<uint32_t> common = randomList(rng, universe, 1 + rng() % 50);
+    for (auto &list : lists)
+    {
+        vector<uint32_t> merged;
+        set_union(list.begin(), list.end(), common.begin(), common.end(), back_inserter(merged));
+        list.swap(merged);
+    }
+    return lists;
+}
+
+static vector<uint32_t> expectedIntersection(const vector<vector<uint32_t>> &lists)
+{
+    vector<uint32_t> result = lists[0];
+    for (size_t l = 1; l < lists.size(); ++l)
+    {
+        vector<uint32_t> next;
+        set_intersection(result.begin(), result.end(), lists[l].begin(), lists[l].end(), back_inserter(next));
+        result.swap(next);
+    }
+    return result;
+}
+
+// Ascending gaps from 0, seven bits per byte, as CompactGraph stores sorted lists
+static vector<uint8_t> encodeCompact(const vector<uint32_t> &list)
+{
+    vector<uint8_t> bytes;
+    uint32_t previous = 0;
+    for (uint32_t id : list)
+    {
+        uint32_t gap = id - previous;
+        previous = id;
+        while (gap >= 0x80)
+        {
+            bytes.push_back((uint8_t)(gap | 0x80));
+            gap >>= 7;
+        }
+        bytes.push_back((uint8_t)gap);
+    }
+    return bytes;
+}
+
+static bool checkRound(mt19937 &rng, CheckPath path)
+{
+    size_t universe = 0;
+    vector<vector<uint32_t>> lists = randomLists(rng, path, universe);
+    vector<uint32_t> expected = expectedIntersection(lists);
+
+    vector<AdjacencyRange> ranges;
+    vector<vector<uint8_t>> coded;
+    for (const auto &list : lists)
+    {
+        ranges.push_back({list.data(), list.data() + list.size()});
+        coded.push_back(encodeCompact(list));
+    }
+
+    vector<CompactRange> compact;
+    for (size_t l = 0; l < lists.size(); ++l)
+        compact.push_back({coded[l].data(), (uint32_t)lists[l].size(), false});
+
+    vector<uint32_t> result;
+    intersectSorted(ranges, universe, result);
+    if (result != expected)
+    {
+        cerr << "Mismatch over plain lists: " << result.size() << " ids, expected " << expected.size() << endl;
+        return false;
+    }
+
+    intersectSorted(compact, universe, result);
+    if (result != expected)
+    {
+        cerr << "Mismatch over compact lists: " << result.size() << " ids, expected " << expected.size() << endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    int rounds = CHECK_DEFAULT_ROUNDS;
+    unsigned int seed = 12345;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        string flag = argv[i];
+        if (flag == "-n")
+            rounds = atoi(argv[i + 1]);
+        else if (flag == "-s")
+            seed = (unsigned int)strtoul(argv[i + 1], nullptr, 10);
+    }
+
+    const vector<pair<CheckPath, string>> paths = {
+        {CHECK_MERGE, "merge"}, {CHECK_GALLOP, "gallop"}, {CHECK_BITSET, "bitset"}, {CHECK_MIXED, "mixed"}};
+
+    mt19937 rng(seed);
+    for (const auto &[path, name] : paths)
+    {
+        for (int r = 0; r < rounds; ++r)
+        {
+            if (!checkRound(rng, path))
+            {
+                cerr << "Failed on the " << name << " path, round " << r << " (seed " << seed << ")" << endl;
+                return 1;
+            }
+        }
+        cout << name << ": " << rounds << " rounds match std::set_intersection" << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include "centrality.h"
+#include "parallel.h"
+#include "compact_graph.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+// Pull form: every user sums the shares of its followers, so each worker only
+// writes its own range of ranks and no atomics are needed. Users who follow no
+// one spread their rank evenly over everyone.
+template <typename Graph>
+vector<double> computePageRank(const Graph &index, const PageRankOptions &options, int &iterations)
+{
+    size_t users = index.userCount();
+    iterations = 0;
+    if (users == 0)
+        return {};
+
+    int workers = resolveThreadCount(options.threads);
+    vector<double> rank(users, 1.0 / users), next(users), share(users);
+    vector<double> workerDangling(workers), workerDelta(workers);
+
+    while (iterations < options.maxIterations)
+    {
+        iterations++;
+
+        // 1. What each user passes to every user it follows
+        fill(workerDangling.begin(), workerDangling.end(), 0.0);
+        parallelFor(users, workers, [&](size_t begin, size_t end, int worker)
+        {
+            double dangling = 0;
+            for (size_t u = begin; u < end; ++u)
+            {
+                size_t outDegree = index.following((uint32_t)u).size();
+                if (outDegree == 0)
+                {
+                    share[u] = 0;
+                    dangling += rank[u];
+                }
+                else
+                {
+                    share[u] = rank[u] / outDegree;
+                }
+            }
+            workerDangling[worker] = dangling;
+        });
+
+        double dangling = 0;
+        for (double d : workerDangling)
+            dangling += d;
+        double base = (1.0 - options.damping) / users + options.damping * dangling / users;
+
+        // 2. Sparse matrix-vector product over the followers CSR
+        fill(workerDelta.begin(), workerDelta.end(), 0.0);
+        parallelFor(users, workers, [&](size_t begin, size_t end, int worker)
+        {
+            double delta = 0;
+            for (size_t v = begin; v < end; ++v)
+            {
+                double sum = 0;
+                for (uint32_t u : index.followers((uint32_t)v))
+                    sum += share[u];
+                next[v] = base + options.damping * sum;
+                delta += fabs(next[v] - rank[v]);
+            }
+            workerDelta[worker] = delta;
+        });
+
+        rank.swap(next);
+
+        double delta = 0;
+        for (double d : workerDelta)
+            delta += d;
+        if (delta < options.tolerance)
+            break;
+    }
+
+    return rank;
+}
+
+template vector<double> computePageRank(const SocialIndex &, const PageRankOptions &, int &);
+template vector<double> computePageRank(const CompactGraph &, const PageRankOptions &, int &);
@@ -0,0 +1,25 @@
+#ifndef CENTRALITY_H
+#define CENTRALITY_H
+
+#include <vector>
+
+#include "social_index.h"
+
+using namespace std;
+
+// PageRank over the follower graph: following a user passes on a share of the
+// follower's own rank, so followers who are themselves followed count more.
+struct PageRankOptions
+{
+    double damping = 0.85;      // chance of following an edge instead of jumping anywhere
+    double tolerance = 1e-6;    // stop once the ranks move less than this in total (L1)
+    int maxIterations = 100;
+    int threads = 1;            // 0 => all cores
+};
+
+// Ranks by dense id, summing to 1. iterations receives the number of rounds run.
+// Graph is a SocialIndex or a CompactGraph (compact_graph.h).
+template <typename Graph>
+vector<double> computePageRank(const Graph &index, const PageRankOptions &options, int &iterations);
+
+#endif
@@ -0,0 +1,186 @@
+#include "checksum.h"
+#include "compression.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <nmmintrin.h>
+#define CRC32C_HARDWARE 1
+#endif
+
+using namespace std;
+
+// ==================== CRC32C ====================
+
+// Reflected Castagnoli polynomial, the one the SSE4.2 instruction computes
+static const uint32_t CRC32C_POLY = 0x82F63B78;
+
+struct Crc32cTable
+{
+    uint32_t entry[256];
+
+    Crc32cTable()
+    {
+        for (uint32_t byte = 0; byte < 256; ++byte)
+        {
+            uint32_t crc = byte;
+            for (int bit = 0; bit < 8; ++bit)
+                crc = (crc >> 1) ^ ((crc & 1) ? CRC32C_POLY : 0);
+            entry[byte] = crc;
+        }
+    }
+};
+
+static uint32_t crc32cSoftware(const unsigned char *p, size_t size, uint32_t crc)
+{
+    static const Crc32cTable table;
+    for (size_t i = 0; i < size; ++i)
+        crc = table.entry[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+#ifdef CRC32C_HARDWARE
+// Compiled for SSE4.2 on its own, so the rest of the program still runs on older CPUs
+__attribute__((target("sse4.2")))
+static uint32_t crc32cHardware(const unsigned char *p, size_t size, uint32_t crc)
+{
+#ifdef __x86_64__
+    uint64_t wide = crc;
+    for (; size >= 8; p += 8, size -= 8)
+    {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        wide = _mm_crc32_u64(wide, word);
+    }
+    crc = (uint32_t)wide;
+#endif
+    for (; size >= 4; p += 4, size -= 4)
+    {
+        uint32_t word;
+        memcpy(&word, p, 4);
+        crc = _mm_crc32_u32(crc, word);
+    }
+    for (; size > 0; ++p, --size)
+        crc = _mm_crc32_u8(crc, *p);
+    return crc;
+}
+#endif
+
+uint32_t crc32c(const void *data, size_t size, uint32_t crc)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    crc = ~crc;
+#ifdef CRC32C_HARDWARE
+    static const bool hardware = __builtin_cpu_supports("sse4.2");
+    if (hardware)
+        return ~crc32cHardware(p, size, crc);
+#endif
+    return ~crc32cSoftware(p, size, crc);
+}
+
+// ==================== Container ====================
+
+string wrapChecked(const string &stream)
+{
+    uint32_t blocks = (uint32_t)((stream.size() + CHECKED_BLOCK_SIZE - 1) / CHECKED_BLOCK_SIZE);
+
+    string result(CHECKED_MAGIC, 4);
+    result += (char)CHECKED_VERSION;
+    result += string(3, '\0');
+    putU32(result, CHECKED_BLOCK_SIZE);
+    putU32(result, blocks);
+    putU64(result, stream.size());
+    putU32(result, crc32c(result.data(), result.size()));
+
+    for (uint32_t b = 0; b < blocks; ++b)
+    {
+        size_t begin = (size_t)b * CHECKED_BLOCK_SIZE;
+        putU32(result, crc32c(stream.data() + begin, min<size_t>(CHECKED_BLOCK_SIZE, stream.size() - begin)));
+    }
+
+    result += stream;
+    return result;
+}
+
+bool openChecked(const string &comp, CheckedPayload &payload)
+{
+    const unsigned char *bytes = (const unsigned char *)comp.data();
+    if (comp.size() < CHECKED_HEADER_SIZE || bytes[4] != CHECKED_VERSION)
+    {
+        cerr << "Error: Unsupported checked container version" << endl;
+        return false;
+    }
+
+    if (getU32(bytes + 24) != crc32c(bytes, 24))
+    {
+        cerr << "Error: Checked container header is damaged" << endl;
+        return false;
+    }
+
+    payload.blockSize = getU32(bytes + 8);
+    payload.blocks = getU32(bytes + 12);
+    payload.size = getU64(bytes + 16);
+    if (payload.blockSize == 0 || payload.blocks != (payload.size + payload.blockSize - 1) / payload.blockSize ||
+        comp.size() != CHECKED_HEADER_SIZE + 4 * (uint64_t)payload.blocks + payload.size)
+    {
+        cerr << "Error: Checked container is truncated or has a corrupt header" << endl;
+        return false;
+    }
+
+    payload.sums = bytes + CHECKED_HEADER_SIZE;
+    payload.data = payload.sums + 4 * (size_t)payload.blocks;
+    return true;
+}
+
+uint32_t findDamagedBlock(const CheckedPayload &payload, uint32_t first, uint32_t last)
+{
+    for (uint32_t b = first; b < last; ++b)
+    {
+        uint64_t offset = (uint64_t)b * payload.blockSize;
+        size_t size = (size_t)min<uint64_t>(payload.blockSize, payload.size - offset);
+        if (crc32c(payload.data + offset, size) != getU32(payload.sums + 4 * (size_t)b))
+            return b;
+    }
+    return last;
+}
+
+void reportDamagedBlock(const CheckedPayload &payload, uint32_t block)
+{
+    cerr << "Error: Checksum mismatch in block " << block << " (bytes " << (uint64_t)block * payload.blockSize
+         << " to " << min<uint64_t>((uint64_t)(block + 1) * payload.blockSize, payload.size)
+         << " of the stream); the file is damaged" << endl;
+}
+
+bool verifyChecked(const CheckedPayload &payload, int threads)
+{
+    // Each worker checks a run of blocks; the first damaged one is reported
+    vector<uint32_t> damaged(resolveThreadCount(threads), payload.blocks);
+    parallelFor(payload.blocks, threads, [&](size_t begin, size_t end, int worker)
+    {
+        damaged[worker] = findDamagedBlock(payload, (uint32_t)begin, (uint32_t)end);
+        if (damaged[worker] == end)
+            damaged[worker] = payload.blocks;
+    });
+
+    uint32_t first = *min_element(damaged.begin(), damaged.end());
+    if (first < payload.blocks)
+    {
+        reportDamagedBlock(payload, first);
+        return false;
+    }
+    return true;
+}
+
+bool unwrapChecked(const string &comp, string &stream, int threads)
+{
+    CheckedPayload payload;
+    if (!openChecked(comp, payload) || !verifyChecked(payload, threads))
+        return false;
+
+    stream.assign((const char *)payload.data, (size_t)payload.size);
+    return true;
+}
@@ -0,0 +1,59 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+using namespace std;
+
+// Checked container: every .comp file written by compress() is wrapped in it, so
+// a damaged file is rejected before any of its output is written.
+// Layout (all fields little-endian):
+//   "XCRC", u8 version, 3 reserved bytes, u32 block size, u32 block count,
+//   u64 payload size, u32 CRC32C of the header fields before it,
+//   one u32 CRC32C per payload block, payload (an XBPE, XMLS or XHUF stream).
+const char CHECKED_MAGIC[4] = {'X', 'C', 'R', 'C'};
+const unsigned char CHECKED_VERSION = 1;
+const size_t CHECKED_HEADER_SIZE = 28;
+
+// Blocks are checked by separate threads when decompressing with -j; the blocks of
+// a BPE payload by the threads that expand them
+const uint32_t CHECKED_BLOCK_SIZE = 1 << 16;
+
+// CRC32C (Castagnoli); uses the SSE4.2 crc32 instruction when the CPU has it
+uint32_t crc32c(const void *data, size_t size, uint32_t crc = 0);
+
+string wrapChecked(const string &stream);
+
+// Payload of a checked container, left where it is in the file
+struct CheckedPayload
+{
+    const unsigned char *data = nullptr;
+    uint64_t size = 0;
+    uint32_t blockSize = 0;
+    uint32_t blocks = 0;
+    const unsigned char *sums = nullptr;
+
+    // First block that starts at or after the payload offset
+    uint32_t blockAtOrAfter(uint64_t offset) const
+    {
+        return (uint32_t)min<uint64_t>((offset + blockSize - 1) / blockSize, blocks);
+    }
+};
+
+// Validates the header and block table only; no payload byte is read
+bool openChecked(const string &comp, CheckedPayload &payload);
+
+// First damaged block of [first, last), or last when they all match
+uint32_t findDamagedBlock(const CheckedPayload &payload, uint32_t first, uint32_t last);
+void reportDamagedBlock(const CheckedPayload &payload, uint32_t block);
+
+// Checks every block on up to threads workers and reports the first damaged one
+bool verifyChecked(const CheckedPayload &payload, int threads);
+
+// Verifies every block (on up to threads workers) and returns a copy of the payload
+bool unwrapChecked(const string &comp, string &stream, int threads);
+
+#endif
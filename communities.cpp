@@ -0,0 +1,182 @@
+#include "communities.h"
+#include "parallel.h"
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <sstream>
+
+using namespace std;
+
+// Renumbers labels 0, 1, 2, ... by the first user carrying each one
+static void renumberClusters(vector<uint32_t> &label)
+{
+    vector<uint32_t> number(label.size(), SOCIAL_NO_USER);
+    uint32_t clusters = 0;
+    for (uint32_t &l : label)
+    {
+        if (number[l] == SOCIAL_NO_USER)
+            number[l] = clusters++;
+        l = number[l];
+    }
+}
+
+// ==================== Components ====================
+
+// Roots are only ever linked under smaller roots, with a compare-and-swap that fails
+// if another worker linked them first, so the smallest user ends up as the root
+static uint32_t findRoot(atomic<uint32_t> *parent, uint32_t x)
+{
+    while (true)
+    {
+        uint32_t p = parent[x].load(memory_order_relaxed);
+        if (p == x)
+            return x;
+        // Path halving; losing this race only leaves a longer path
+        uint32_t grandparent = parent[p].load(memory_order_relaxed);
+        parent[x].compare_exchange_weak(p, grandparent, memory_order_relaxed);
+        x = grandparent;
+    }
+}
+
+static void unite(atomic<uint32_t> *parent, uint32_t a, uint32_t b)
+{
+    while (true)
+    {
+        a = findRoot(parent, a);
+        b = findRoot(parent, b);
+        if (a == b)
+            return;
+        if (a < b)
+            swap(a, b);
+        uint32_t expected = a;
+        if (parent[a].compare_exchange_strong(expected, b, memory_order_relaxed))
+            return;
+    }
+}
+
+vector<uint32_t> weakComponents(const SocialIndex &index, int threads)
+{
+    size_t users = index.userCount();
+    unique_ptr<atomic<uint32_t>[]> parent(new atomic<uint32_t>[users]);
+    for (uint32_t u = 0; u < users; ++u)
+        parent[u].store(u, memory_order_relaxed);
+
+    parallelFor(users, threads, [&](size_t begin, size_t end, int)
+    {
+        for (size_t v = begin; v < end; ++v)
+        {
+            for (uint32_t u : index.followers((uint32_t)v))
+                unite(parent.get(), (uint32_t)v, u);
+        }
+    });
+
+    vector<uint32_t> label(users);
+    parallelFor(users, threads, [&](size_t begin, size_t end, int)
+    {
+        for (size_t v = begin; v < end; ++v)
+            label[v] = findRoot(parent.get(), (uint32_t)v);
+    });
+
+    renumberClusters(label);
+    return label;
+}
+
+// ==================== Label Propagation ====================
+
+vector<uint32_t> labelPropagation(const SocialIndex &index, int maxIterations, int threads, int &iterations)
+{
+    size_t users = index.userCount();
+    vector<uint32_t> label(users), next(users);
+    for (uint32_t u = 0; u < users; ++u)
+        label[u] = u;
+
+    // Per worker: votes per label, reset through the list of labels seen
+    int workers = resolveThreadCount(threads);
+    vector<vector<uint32_t>> workerVotes(workers), workerSeen(workers);
+    vector<size_t> workerChanges(workers);
+
+    iterations = 0;
+    while (iterations < maxIterations)
+    {
+        iterations++;
+        fill(workerChanges.begin(), workerChanges.end(), 0);
+
+        parallelFor(users, workers, [&](size_t begin, size_t end, int worker)
+        {
+            vector<uint32_t> &votes = workerVotes[worker];
+            vector<uint32_t> &seen = workerSeen[worker];
+            if (votes.empty())
+                votes.assign(users, 0);
+            size_t changes = 0;
+
+            for (size_t v = begin; v < end; ++v)
+            {
+                auto vote = [&](uint32_t l)
+                {
+                    if (votes[l]++ == 0)
+                        seen.push_back(l);
+                };
+                for (uint32_t u : index.followers((uint32_t)v))
+                    vote(label[u]);
+                for (uint32_t u : index.following((uint32_t)v))
+                    vote(label[u]);
+
+                // A user keeps its label while it is among the most common, which
+                // stops neighbours from swapping labels back and forth every round
+                uint32_t best = label[v], bestVotes = votes[best];
+                for (uint32_t l : seen)
+                {
+                    if (votes[l] > bestVotes || (votes[l] == bestVotes && l < best && votes[label[v]] < bestVotes))
+                    {
+                        best = l;
+                        bestVotes = votes[l];
+                    }
+                }
+                for (uint32_t l : seen)
+                    votes[l] = 0;
+                seen.clear();
+
+                next[v] = best;
+                changes += best != label[v];
+            }
+            workerChanges[worker] = changes;
+        });
+
+        label.swap(next);
+
+        size_t changes = 0;
+        for (size_t c : workerChanges)
+            changes += c;
+        if (changes == 0)
+            break;
+    }
+
+    renumberClusters(label);
+    return label;
+}
+
+// ==================== Report ====================
+
+string describeClusters(const SocialIndex &index, const vector<uint32_t> &cluster, const string &kind)
+{
+    stringstream out;
+    vector<size_t> size;
+    for (uint32_t u = 0; u < cluster.size(); ++u)
+    {
+        out << "User ID: " << index.externalId(u) << ", " << kind << ": " << cluster[u] << "\n";
+        if (cluster[u] >= size.size())
+            size.resize(cluster[u] + 1, 0);
+        size[cluster[u]]++;
+    }
+
+    // Largest clusters first
+    map<size_t, size_t, greater<size_t>> histogram;
+    for (size_t s : size)
+        histogram[s]++;
+
+    out << kind << " count: " << size.size() << "\n";
+    for (const auto &bucket : histogram)
+        out << "Size " << bucket.first << ": " << bucket.second << "\n";
+    return out.str();
+}
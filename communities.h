@@ -0,0 +1,27 @@
+#ifndef COMMUNITIES_H
+#define COMMUNITIES_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "social_index.h"
+
+using namespace std;
+
+// Both treat the follower graph as undirected: following either way links two users.
+// Cluster ids are numbered 0, 1, 2, ... in the order their first user appears in
+// the dense order, so the output does not depend on the thread count.
+
+// Weakly connected components, by a lock-free union-find shared by all workers
+vector<uint32_t> weakComponents(const SocialIndex &index, int threads);
+
+// Communities by synchronous label propagation: every round each user takes the
+// label most common among its neighbours (keeping its own on a tie if it is one of
+// them, else the smallest), until no label changes or maxIterations rounds have run
+vector<uint32_t> labelPropagation(const SocialIndex &index, int maxIterations, int threads, int &iterations);
+
+// One "User ID: x, <kind>: c" line per user, then the cluster size histogram
+string describeClusters(const SocialIndex &index, const vector<uint32_t> &cluster, const string &kind);
+
+#endif
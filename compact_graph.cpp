@@ -0,0 +1,189 @@
+#include "compact_graph.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+
+static void putCompactVarint(vector<uint8_t> &out, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+// Appends the values of list as gaps, zigzag-coded when they may go down
+static void putGaps(vector<uint8_t> &out, const AdjacencyRange &list, bool signedGaps)
+{
+    uint32_t previous = 0;
+    for (uint32_t id : list)
+    {
+        uint32_t gap = id - previous;
+        if (signedGaps)
+            gap = (gap << 1) ^ (uint32_t)((int32_t)gap >> 31);
+        putCompactVarint(out, gap);
+        previous = id;
+    }
+}
+
+// Count, byte length, then the values
+static void putList(vector<uint8_t> &out, vector<uint8_t> &scratch, const AdjacencyRange &list, bool signedGaps)
+{
+    scratch.clear();
+    putGaps(scratch, list, signedGaps);
+    putCompactVarint(out, (uint32_t)list.size());
+    putCompactVarint(out, (uint32_t)scratch.size());
+    out.insert(out.end(), scratch.begin(), scratch.end());
+}
+
+bool encodeCompactLists(size_t users, int threads, const function<UserLists(uint32_t, vector<uint32_t> &)> &lists,
+                        const function<void(size_t)> &coded, CompactLists &out)
+{
+    int workers = resolveThreadCount(threads);
+    out.bytes.clear();
+    out.blocks.assign((users + COMPACT_BLOCK_USERS - 1) / COMPACT_BLOCK_USERS, 0);
+    out.offsets.assign(users, 0);
+
+    // Each worker codes a contiguous run of the round's users into its own bytes;
+    // offsets are relative to those bytes until the runs are joined in order
+    vector<vector<uint8_t>> parts(workers);
+    vector<size_t> partBegin(workers, 0), partEnd(workers, 0);
+    vector<uint64_t> offsets;
+
+    for (size_t first = 0; first < users; first += COMPACT_ROUND_USERS)
+    {
+        size_t last = min(users, first + COMPACT_ROUND_USERS);
+        offsets.assign(last - first, 0);
+
+        parallelFor(last - first, workers, [&](size_t begin, size_t end, int worker)
+        {
+            vector<uint8_t> &part = parts[worker];
+            vector<uint8_t> scratch;
+            vector<uint32_t> sortedScratch;
+            part.clear();
+            partBegin[worker] = begin;
+            partEnd[worker] = end;
+            for (size_t i = begin; i < end; ++i)
+            {
+                UserLists user = lists((uint32_t)(first + i), sortedScratch);
+                offsets[i] = part.size();
+                putList(part, scratch, user.followers, true);
+                putList(part, scratch, user.following, false);
+                putCompactVarint(part, (uint32_t)user.sorted.size());
+                putGaps(part, user.sorted, false);
+            }
+        });
+
+        for (int w = 0; w < workers; ++w)
+        {
+            for (size_t i = partBegin[w]; i < partEnd[w]; ++i)
+                offsets[i] += out.bytes.size();
+            out.bytes.insert(out.bytes.end(), parts[w].begin(), parts[w].end());
+            partBegin[w] = partEnd[w] = 0;
+        }
+
+        for (size_t u = first; u < last; ++u)
+        {
+            if (u % COMPACT_BLOCK_USERS == 0)
+                out.blocks[u / COMPACT_BLOCK_USERS] = offsets[u - first];
+            uint64_t within = offsets[u - first] - out.blocks[u / COMPACT_BLOCK_USERS];
+            if (within > UINT32_MAX)
+            {
+                cerr << "Error: The lists of users " << u / COMPACT_BLOCK_USERS * COMPACT_BLOCK_USERS << " to " << u
+                     << " take more than 4 GiB; they cannot be coded compactly" << endl;
+                return false;
+            }
+            out.offsets[u] = (uint32_t)within;
+        }
+
+        if (coded)
+            coded(last);
+    }
+    return true;
+}
+
+// readCompactVarint that stops at end and at more than five bytes
+static bool readCheckedVarint(const uint8_t *&p, const uint8_t *end, uint32_t &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 35; shift += 7)
+    {
+        if (p == end)
+            return false;
+        uint8_t byte = *p++;
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+// Decodes count values from [p, end); false if they run past end or one is not
+// below users (or, for strictly ascending lists, repeats)
+static bool checkGaps(const uint8_t *&p, const uint8_t *end, uint32_t count, bool signedGaps, bool strict,
+                      size_t users)
+{
+    uint32_t value = 0, gap;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        if (!readCheckedVarint(p, end, gap))
+            return false;
+        if (strict && i > 0 && gap == 0)
+            return false;
+        uint32_t next = value + (signedGaps ? (uint32_t)((gap >> 1) ^ (0u - (gap & 1))) : gap);
+        if (next >= users || (!signedGaps && next < value))
+            return false;
+        value = next;
+    }
+    return true;
+}
+
+bool checkCompactLists(const uint8_t *bytes, size_t size, const uint64_t *blocks, const uint32_t *offsets,
+                       size_t users)
+{
+    const uint8_t *end = bytes + size;
+    for (size_t u = 0; u < users; ++u)
+    {
+        uint64_t start = blocks[u / COMPACT_BLOCK_USERS];
+        if (start > size || offsets[u] > size - start)
+            return false;
+
+        // Followers and following: count, byte length, values filling that length
+        const uint8_t *p = bytes + start + offsets[u];
+        uint32_t count, length;
+        for (bool signedGaps : {true, false})
+        {
+            if (!readCheckedVarint(p, end, count) || !readCheckedVarint(p, end, length) ||
+                length > (size_t)(end - p))
+                return false;
+            const uint8_t *listEnd = p + length;
+            if (!checkGaps(p, listEnd, count, signedGaps, false, users) || p != listEnd)
+                return false;
+        }
+
+        if (!readCheckedVarint(p, end, count) || !checkGaps(p, end, count, false, true, users))
+            return false;
+    }
+    return true;
+}
+
+bool CompactGraph::build(SocialIndex &index, int threads)
+{
+    if (!index.hasCodedLists() && !index.codeLists(threads, true))
+        return false;
+
+    ids_Index = &index;
+    list_Bytes = index.codedLists();
+    block_Offsets = index.codedBlocks();
+    user_Offsets = index.codedOffsets();
+    return true;
+}
+
+size_t CompactGraph::memoryBytes() const
+{
+    return ids_Index->codedBytes();
+}
@@ -0,0 +1,192 @@
+#ifndef COMPACT_GRAPH_H
+#define COMPACT_GRAPH_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <iterator>
+#include <functional>
+
+#include "social_index.h"
+
+using namespace std;
+
+// Seven bits per byte, low bits first; the high bit marks that more follow
+inline uint32_t readCompactVarint(const uint8_t *&p)
+{
+    uint32_t value = 0;
+    int shift = 0;
+    uint8_t byte;
+    do
+    {
+        byte = *p++;
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    return value;
+}
+
+// Walks one varint-coded list, decoding a value per step. Ascending lists store
+// the gap to the previous value (the first one from 0), so repeats cost one byte;
+// lists in document order store the zigzag-coded difference instead.
+class CompactIterator {
+private:
+    const uint8_t *next_Byte = nullptr;
+    uint32_t values_Left = 0;
+    uint32_t current_Value = 0;
+    bool signed_Gaps = false;
+
+    void decode()
+    {
+        uint32_t gap = readCompactVarint(next_Byte);
+        current_Value += signed_Gaps ? (uint32_t)((gap >> 1) ^ (0u - (gap & 1))) : gap;
+    }
+
+public:
+    typedef input_iterator_tag iterator_category;
+    typedef uint32_t value_type;
+    typedef ptrdiff_t difference_type;
+    typedef const uint32_t *pointer;
+    typedef uint32_t reference;
+
+    CompactIterator() = default;
+    CompactIterator(const uint8_t *bytes, uint32_t count, bool signedGaps)
+        : next_Byte(bytes), values_Left(count), signed_Gaps(signedGaps)
+    {
+        if (values_Left)
+            decode();
+    }
+
+    uint32_t operator*() const { return current_Value; }
+
+    CompactIterator &operator++()
+    {
+        if (--values_Left)
+            decode();
+        return *this;
+    }
+
+    // Only the number of values left is compared, so any exhausted iterator is end()
+    bool operator==(const CompactIterator &other) const { return values_Left == other.values_Left; }
+    bool operator!=(const CompactIterator &other) const { return values_Left != other.values_Left; }
+};
+
+// One list of a CompactGraph; the count is known without decoding the values
+struct CompactRange
+{
+    const uint8_t *first;
+    uint32_t count;
+    bool signedGaps;
+
+    CompactIterator begin() const { return CompactIterator(first, count, signedGaps); }
+    CompactIterator end() const { return CompactIterator(); }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+};
+
+// Users per entry of the coarse offset table of a CompactGraph
+const uint32_t COMPACT_BLOCK_USERS = 64;
+
+// Users coded per round by encodeCompactLists: the workers' bytes are joined
+// after each round, so only one round is held twice
+const size_t COMPACT_ROUND_USERS = 64 * 1024;
+
+// The three lists of one user, as encodeCompactLists reads them
+struct UserLists
+{
+    AdjacencyRange followers, following, sorted;
+};
+
+// Coded lists and their offsets, laid out as a CompactGraph reads them
+struct CompactLists
+{
+    vector<uint8_t> bytes;
+    vector<uint64_t> blocks;
+    vector<uint32_t> offsets;
+};
+
+// Codes the lists of users 0..users-1 into out, in rounds of COMPACT_ROUND_USERS
+// users on up to threads workers. lists(user, scratch) gives the lists of a user
+// and may build the sorted one in scratch; coded(end), if set, is called once every
+// user below end is coded, so their plain lists may be dropped. False if the lists
+// of one block of users do not fit the u32 offsets.
+bool encodeCompactLists(size_t users, int threads, const function<UserLists(uint32_t, vector<uint32_t> &)> &lists,
+                        const function<void(size_t)> &coded, CompactLists &out);
+
+// True if the coded lists of users 0..users-1 lie inside the size bytes and hold
+// only ids below users, the sorted ones ascending and free of repeats; for
+// lists read from a snapshot
+bool checkCompactLists(const uint8_t *bytes, size_t size, const uint64_t *blocks, const uint32_t *offsets,
+                       size_t users);
+
+// The follower and following lists of a SocialIndex, varint-coded: about one to
+// three bytes per edge instead of four. The three lists of a user are stored back
+// to back in one run of bytes:
+//   varint count, varint byte length, followers (document order, zigzag differences)
+//   varint count, varint byte length, following (ascending gaps)
+//   varint count, sorted followers (ascending gaps, no repeats)
+// and a run starts at a u64 block offset plus a u32 offset within the block, so the
+// coded lists may pass 4 GiB at a cost of about four bytes per user. Lists are read
+// front to back only. The coded lists belong to the index (SocialIndex::codeLists),
+// which writes them to its snapshot; the graph only reads them, so the index must
+// outlive it.
+class CompactGraph {
+private:
+    const SocialIndex *ids_Index = nullptr;
+    const uint8_t *list_Bytes = nullptr;
+    const uint64_t *block_Offsets = nullptr;  // run of user b * COMPACT_BLOCK_USERS
+    const uint32_t *user_Offsets = nullptr;   // run of user u, from its block offset
+
+    const uint8_t *run(uint32_t user) const
+    {
+        return list_Bytes + block_Offsets[user / COMPACT_BLOCK_USERS] + user_Offsets[user];
+    }
+
+    // The list at p, with p moved past its count and byte length
+    static CompactRange readList(const uint8_t *&p, bool signedGaps)
+    {
+        uint32_t count = readCompactVarint(p);
+        uint32_t length = readCompactVarint(p);
+        CompactRange list = {p, count, signedGaps};
+        p += length;
+        return list;
+    }
+
+public:
+    // Reads the coded lists of index. An index built or mapped without them has its
+    // lists coded on up to threads workers and its plain lists released as they are
+    // coded; false if they do not fit the offsets.
+    bool build(SocialIndex &index, int threads = 1);
+
+    size_t userCount() const { return ids_Index->userCount(); }
+    int externalId(uint32_t user) const { return ids_Index->externalId(user); }
+    uint32_t find(int id) const { return ids_Index->find(id); }
+    const SocialIndex &index() const { return *ids_Index; }
+
+    CompactRange followers(uint32_t user) const
+    {
+        const uint8_t *p = run(user);
+        return readList(p, true);
+    }
+
+    CompactRange following(uint32_t user) const
+    {
+        const uint8_t *p = run(user);
+        readList(p, true);
+        return readList(p, false);
+    }
+
+    CompactRange sortedFollowers(uint32_t user) const
+    {
+        const uint8_t *p = run(user);
+        readList(p, true);
+        readList(p, false);
+        uint32_t count = readCompactVarint(p);
+        return {p, count, false};
+    }
+
+    // Bytes held by the coded lists and their offsets
+    size_t memoryBytes() const;
+};
+
+#endif
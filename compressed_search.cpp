@@ -0,0 +1,456 @@
+#include "compressed_search.h"
+#include "compression.h"
+#include "archive.h"
+#include "xml_codec.h"
+#include "entropy.h"
+#include "checksum.h"
+
+#include <fstream>
+#include <algorithm>
+
+using namespace std;
+
+// ==================== Pattern Automaton ====================
+
+// Patterns the post scanner reacts to; the search pattern itself is the last one
+enum PostPattern
+{
+    PATTERN_POST_OPEN,
+    PATTERN_POST_CLOSE,
+    PATTERN_BODY_OPEN,
+    PATTERN_BODY_CLOSE,
+    PATTERN_NEEDLE
+};
+
+// Aho-Corasick automaton over bytes, stored as a full transition table
+struct PatternAutomaton
+{
+    vector<int32_t> next;    // state * 256 + byte
+    vector<uint8_t> matches; // bit p set: pattern p ends in this state
+    vector<uint32_t> length; // pattern lengths
+
+    void build(const vector<string> &patterns)
+    {
+        next.assign(256, -1);
+        matches.assign(1, 0);
+        length.clear();
+
+        for (size_t p = 0; p < patterns.size(); ++p)
+        {
+            length.push_back((uint32_t)patterns[p].size());
+            if (patterns[p].empty())
+                continue;
+
+            int32_t state = 0;
+            for (unsigned char c : patterns[p])
+            {
+                if (next[state * 256 + c] < 0)
+                {
+                    next[state * 256 + c] = (int32_t)matches.size();
+                    matches.push_back(0);
+                    next.resize(next.size() + 256, -1);
+                }
+                state = next[state * 256 + c];
+            }
+            matches[state] |= 1 << p;
+        }
+
+        // Breadth-first fill of the failure transitions
+        vector<int32_t> fail(matches.size(), 0), queue;
+        for (int c = 0; c < 256; ++c)
+        {
+            if (next[c] < 0)
+                next[c] = 0;
+            else
+                queue.push_back(next[c]);
+        }
+
+        for (size_t q = 0; q < queue.size(); ++q)
+        {
+            int32_t state = queue[q];
+            matches[state] |= matches[fail[state]];
+            for (int c = 0; c < 256; ++c)
+            {
+                int32_t &target = next[state * 256 + c];
+                if (target < 0)
+                    target = next[fail[state] * 256 + c];
+                else
+                {
+                    fail[target] = next[fail[state] * 256 + c];
+                    queue.push_back(target);
+                }
+            }
+        }
+    }
+
+    size_t stateCount() const { return matches.size(); }
+};
+
+// ==================== Post Scanner ====================
+
+const uint64_t NOT_SEEN = ~0ull;
+
+// Follows searchPostsByWord / searchPostsByTopic event by event: a post runs from
+// <post> to the first </post> after it, and only the first <body> / </body> count
+struct PostScanner
+{
+    bool isWord;
+    bool emptyNeedle;
+    vector<pair<uint64_t, uint64_t>> bodies; // matching body ranges
+
+    bool inPost = false;
+    uint64_t postStart = 0;
+    uint64_t bodyOpen = NOT_SEEN;
+    uint64_t bodyClose = NOT_SEEN;
+    uint64_t needleEnd = NOT_SEEN;
+
+    void event(int pattern, uint64_t start, uint64_t end)
+    {
+        switch (pattern)
+        {
+        case PATTERN_POST_OPEN:
+            if (!inPost)
+            {
+                inPost = true;
+                postStart = start;
+                bodyOpen = bodyClose = needleEnd = NOT_SEEN;
+            }
+            break;
+        case PATTERN_BODY_OPEN:
+            if (inPost && bodyOpen == NOT_SEEN)
+                bodyOpen = start;
+            break;
+        case PATTERN_BODY_CLOSE:
+            if (inPost && bodyClose == NOT_SEEN)
+                bodyClose = start;
+            break;
+        case PATTERN_NEEDLE:
+            // A word counts from the start of the body text, a topic anywhere in the post
+            if (inPost && needleEnd == NOT_SEEN &&
+                (isWord ? bodyOpen != NOT_SEEN && start >= bodyOpen + 6 : start >= postStart))
+                needleEnd = end;
+            break;
+        case PATTERN_POST_CLOSE:
+            if (inPost)
+            {
+                closePost(start);
+                inPost = false;
+            }
+            break;
+        }
+    }
+
+    void closePost(uint64_t postEnd)
+    {
+        if (bodyOpen == NOT_SEEN || bodyClose == NOT_SEEN)
+            return;
+
+        uint64_t textStart = bodyOpen + 6;
+        if (isWord)
+        {
+            if (bodyClose > bodyOpen && (emptyNeedle || needleEnd <= bodyClose))
+                bodies.push_back({textStart, bodyClose});
+        }
+        else if (needleEnd != NOT_SEEN)
+        {
+            // A </body> before the <body> leaves the rest of the post, as substr does
+            bodies.push_back({textStart, bodyClose >= textStart ? bodyClose : postEnd});
+        }
+    }
+};
+
+// ==================== Symbol Stream Search ====================
+
+// Automaton state after reading one symbol from one state. Short symbols keep their
+// matches; long ones are walked through their halves whenever they have any.
+struct SymbolStep
+{
+    int32_t next = -1; // -1: not computed yet
+    bool hasMatches = false;
+    uint32_t firstMatch = 0;
+    uint32_t matchCount = 0;
+};
+
+struct SymbolMatch
+{
+    uint32_t end; // offset just past the match inside the symbol text
+    uint8_t pattern;
+};
+
+// The pattern automaton lifted from bytes to dictionary symbols
+class SymbolAutomaton {
+private:
+    const BPEStream &stream;
+    const BPEExpansionTable &table;
+    const PatternAutomaton &automaton;
+    size_t symbolCount;
+    vector<SymbolStep> steps;
+    vector<SymbolMatch> matches;
+
+    SymbolStep &at(int32_t state, uint32_t symbol) { return steps[(size_t)state * symbolCount + symbol]; }
+
+    void runText(int32_t state, uint32_t symbol)
+    {
+        SymbolStep &step = at(state, symbol);
+        const string &text = table.text[symbol];
+        step.firstMatch = (uint32_t)matches.size();
+        for (size_t i = 0; i < text.size(); ++i)
+        {
+            state = automaton.next[state * 256 + (unsigned char)text[i]];
+            for (uint8_t bits = automaton.matches[state], p = 0; bits; bits >>= 1, ++p)
+            {
+                if (bits & 1)
+                    matches.push_back({(uint32_t)(i + 1), p});
+            }
+        }
+        step.matchCount = (uint32_t)matches.size() - step.firstMatch;
+        step.hasMatches = step.matchCount > 0;
+        step.next = state;
+    }
+
+public:
+    SymbolAutomaton(const BPEStream &s, const BPEExpansionTable &t, const PatternAutomaton &a)
+        : stream(s), table(t), automaton(a), symbolCount(s.symbols.size()),
+          steps(a.stateCount() * s.symbols.size()) {}
+
+    // Computes the step for (state, symbol) and, for long symbols, the steps of
+    // their halves. Nesting can run thousands deep, so the frames live on a stack.
+    const SymbolStep &step(int32_t state, uint32_t symbol)
+    {
+        if (at(state, symbol).next >= 0)
+            return at(state, symbol);
+
+        vector<pair<int32_t, uint32_t>> pending{{state, symbol}};
+        while (!pending.empty())
+        {
+            auto [q, x] = pending.back();
+            if (at(q, x).next >= 0)
+            {
+                pending.pop_back();
+                continue;
+            }
+            if (table.length[x] <= BPE_CACHED_EXPANSION)
+            {
+                runText(q, x);
+                pending.pop_back();
+                continue;
+            }
+
+            const SymbolStep &first = at(q, stream.symbols[x].first);
+            if (first.next < 0)
+            {
+                pending.push_back({q, stream.symbols[x].first});
+                continue;
+            }
+            const SymbolStep &second = at(first.next, stream.symbols[x].second);
+            if (second.next < 0)
+            {
+                pending.push_back({first.next, stream.symbols[x].second});
+                continue;
+            }
+
+            SymbolStep &done = at(q, x);
+            done.next = second.next;
+            done.hasMatches = first.hasMatches || second.hasMatches;
+            pending.pop_back();
+        }
+        return at(state, symbol);
+    }
+
+    // Reports the matches of a symbol read in the given state at the given offset
+    void report(int32_t state, uint32_t symbol, uint64_t offset, PostScanner &scanner)
+    {
+        struct Frame { int32_t state; uint32_t symbol; uint64_t offset; };
+        vector<Frame> pending{{state, symbol, offset}};
+        while (!pending.empty())
+        {
+            Frame frame = pending.back();
+            pending.pop_back();
+
+            const SymbolStep &current = at(frame.state, frame.symbol);
+            if (!current.hasMatches)
+                continue;
+
+            if (table.length[frame.symbol] <= BPE_CACHED_EXPANSION)
+            {
+                for (uint32_t m = 0; m < current.matchCount; ++m)
+                {
+                    const SymbolMatch &match = matches[current.firstMatch + m];
+                    uint64_t end = frame.offset + match.end;
+                    scanner.event(match.pattern, end - automaton.length[match.pattern], end);
+                }
+                continue;
+            }
+
+            // Second half goes on the stack first so the first half is reported first
+            uint32_t first = stream.symbols[frame.symbol].first;
+            uint32_t second = stream.symbols[frame.symbol].second;
+            pending.push_back({at(frame.state, first).next, second, frame.offset + table.length[first]});
+            pending.push_back({frame.state, first, frame.offset});
+        }
+    }
+};
+
+static bool searchSymbolStream(const BPEStream &stream, const PatternAutomaton &automaton,
+                               PostScanner &scanner, vector<string> &results)
+{
+    BPEExpansionTable table;
+    if (!buildExpansionTable(stream, table))
+        return false;
+
+    SymbolAutomaton symbols(stream, table, automaton);
+    scanner.bodies.clear();
+
+    int32_t state = 0;
+    uint64_t offset = 0;
+    uint32_t symbol;
+    for (size_t k = 0; k < stream.dataSize;)
+    {
+        if (!readSymbol(stream, k, symbol))
+        {
+            cerr << "Error: Corrupt symbol data" << endl;
+            return false;
+        }
+
+        const SymbolStep &step = symbols.step(state, symbol);
+        if (step.hasMatches)
+            symbols.report(state, symbol, offset, scanner);
+
+        state = step.next;
+        offset += table.length[symbol];
+    }
+
+    // Second pass: expand just the matching bodies. They are sorted and disjoint,
+    // so each symbol is descended into at most once.
+    const auto &bodies = scanner.bodies;
+    size_t next = 0;
+    string body;
+    vector<pair<uint32_t, uint64_t>> pending;
+    offset = 0;
+    for (size_t k = 0; k < stream.dataSize && next < bodies.size();)
+    {
+        readSymbol(stream, k, symbol);
+        uint64_t symbolEnd = offset + table.length[symbol];
+
+        pending.assign(1, {symbol, offset});
+        while (!pending.empty() && next < bodies.size())
+        {
+            auto [piece, at] = pending.back();
+            pending.pop_back();
+            uint64_t length = table.length[piece];
+            if (at + length <= bodies[next].first)
+                continue;
+
+            if (length > BPE_CACHED_EXPANSION)
+            {
+                uint32_t first = stream.symbols[piece].first;
+                pending.push_back({stream.symbols[piece].second, at + table.length[first]});
+                pending.push_back({first, at});
+                continue;
+            }
+
+            // A short piece can hold the end of one body and the start of the next
+            while (next < bodies.size() && bodies[next].first < at + length)
+            {
+                auto [begin, end] = bodies[next];
+                uint64_t from = begin > at ? begin - at : 0;
+                uint64_t to = min<uint64_t>(length, end - at);
+                if (to > from)
+                    body.append(table.text[piece], from, to - from);
+                if (end > at + length)
+                    break;
+                results.push_back(move(body));
+                body.clear();
+                next++;
+            }
+        }
+        offset = symbolEnd;
+    }
+
+    // Empty bodies at the very end never overlap a symbol
+    for (; next < bodies.size(); ++next)
+    {
+        results.push_back(move(body));
+        body.clear();
+    }
+    return true;
+}
+
+// ==================== Entry Points ====================
+
+bool isCompressedFile(const string &path)
+{
+    ifstream file(path, ios::binary);
+    unsigned char head[8];
+    if (!file.read((char *)head, 8))
+        return false;
+
+    for (const char *magic : {CHECKED_MAGIC, WIDE_BPE_MAGIC, XML_CODEC_MAGIC, ENTROPY_MAGIC, ARCHIVE_MAGIC})
+    {
+        if (memcmp(head, magic, 4) == 0)
+            return true;
+    }
+
+    // Plain streams start with a little-endian dictionary count, so NUL bytes XML never has
+    uint64_t dictionary = getU64(head);
+    return dictionary <= 256 - BPE_FIRST_SYMBOL;
+}
+
+bool searchCompressedPosts(const string &comp, const string &pattern, bool isWord,
+                           vector<string> &results)
+{
+    results.clear();
+
+    if (comp.compare(0, 4, CHECKED_MAGIC, 4) == 0)
+    {
+        string inner;
+        return unwrapChecked(comp, inner, 0) && searchCompressedPosts(inner, pattern, isWord, results);
+    }
+
+    if (comp.compare(0, 4, ENTROPY_MAGIC, 4) == 0)
+    {
+        string inner;
+        return entropyDecode(comp, inner) && searchCompressedPosts(inner, pattern, isWord, results);
+    }
+
+    // Structural streams keep no byte offsets to search by, so they are rebuilt and
+    // searched as text (their containers still decode in parallel)
+    if (comp.compare(0, 4, XML_CODEC_MAGIC, 4) == 0)
+    {
+        string xml;
+        if (!decompressStructural(comp, xml, 0))
+            return false;
+        results = isWord ? searchPostsByWord(xml, pattern) : searchPostsByTopic(xml, pattern);
+        return true;
+    }
+
+    string needle = isWord ? pattern : "<topic>" + pattern + "</topic>";
+    PatternAutomaton automaton;
+    automaton.build({"<post>", "</post>", "<body>", "</body>", needle});
+
+    PostScanner scanner;
+    scanner.isWord = isWord;
+    scanner.emptyNeedle = needle.empty();
+
+    // Archive blocks end at </user>, so no post spans two of them
+    if (comp.compare(0, 4, ARCHIVE_MAGIC, 4) == 0)
+    {
+        vector<ArchiveBlock> blocks;
+        if (!parseArchive(comp, blocks))
+            return false;
+
+        for (uint32_t b = 0; b < blocks.size(); ++b)
+        {
+            scanner.inPost = false;
+            const unsigned char *data = (const unsigned char *)comp.data() + blocks[b].fileOffset;
+            BPEStream stream;
+            if (!verifyArchiveBlock(blocks[b], data, b) || !parseBPEStream(data, blocks[b].compressedSize, stream) ||
+                !searchSymbolStream(stream, automaton, scanner, results))
+                return false;
+        }
+        return true;
+    }
+
+    BPEStream stream;
+    return parseBPEStream(comp, stream) && searchSymbolStream(stream, automaton, scanner, results);
+}
@@ -0,0 +1,23 @@
+#ifndef COMPRESSED_SEARCH_H
+#define COMPRESSED_SEARCH_H
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Post search on compressed input (.comp streams of every mode and level, .xarc archives).
+// Results match searchPostsByWord / searchPostsByTopic on the decompressed document.
+//
+// BPE streams are never expanded as a whole: the tags and the pattern are compiled into
+// one automaton, each (automaton state, dictionary symbol) step is computed once and
+// reused, and only the bodies of matching posts are expanded at the end.
+// Structural (xml mode) streams are rebuilt first.
+
+// True when the file starts like one of the compressed formats rather than XML text
+bool isCompressedFile(const string &path);
+
+bool searchCompressedPosts(const string &comp, const string &pattern, bool isWord,
+                           vector<string> &results);
+
+#endif
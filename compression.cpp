@@ -0,0 +1,817 @@
+#include "compression.h"
+#include "archive.h"
+#include "xml_codec.h"
+#include "entropy.h"
+#include "dictionary.h"
+#include "checksum.h"
+#include "parallel.h"
+#include "utils.h"
+
+#include <queue>
+#include <unordered_map>
+
+using namespace std;
+
+// ==================== Byte Order Helpers ====================
+
+void putU32(string &out, uint32_t value)
+{
+    for (int i = 0; i < 4; ++i)
+        out += (char)((value >> (8 * i)) & 0xFF);
+}
+
+void putU64(string &out, uint64_t value)
+{
+    for (int i = 0; i < 8; ++i)
+        out += (char)((value >> (8 * i)) & 0xFF);
+}
+
+uint32_t getU32(const unsigned char *bytes)
+{
+    return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) |
+           ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+uint64_t getU64(const unsigned char *bytes)
+{
+    return (uint64_t)getU32(bytes) | ((uint64_t)getU32(bytes + 4) << 32);
+}
+
+void putVarint(string &out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out += (char)(0x80 | (value & 0x7F));
+        value >>= 7;
+    }
+    out += (char)value;
+}
+
+bool getVarint(const unsigned char *&p, const unsigned char *end, uint64_t &value)
+{
+    value = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7)
+    {
+        unsigned char byte = *p++;
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if (byte < 0x80)
+            return true;
+    }
+    return false;
+}
+
+// ==================== Encoding ====================
+
+bool needsWideSymbols(const string &text)
+{
+    for (unsigned char c : text)
+    {
+        if (c >= BPE_FIRST_SYMBOL)
+            return true;
+    }
+    return false;
+}
+
+// Learns byte pair merges in one pass over the data instead of one pass per merge.
+// Every pair keeps a count and the positions it occurs at; the symbols form a
+// linked list, so replacing an occurrence only touches its two neighbours.
+// A max-heap of (count, pair) picks the next merge; entries whose count went
+// down since they were pushed are re-pushed with the current count when popped.
+void learnBPEMerges(vector<uint32_t> &symbols, uint32_t firstSymbol, size_t maxMerges,
+                    uint32_t minCount, vector<pair<uint32_t, uint32_t>> &merges)
+{
+    merges.clear();
+    size_t n = symbols.size();
+    if (n < 2 || maxMerges == 0)
+        return;
+
+    const uint32_t NONE = 0xFFFFFFFF; // no neighbour, or a symbol merged into its left neighbour
+    vector<uint32_t> prev(n), next(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        prev[i] = i == 0 ? NONE : (uint32_t)(i - 1);
+        next[i] = i + 1 == n ? NONE : (uint32_t)(i + 1);
+    }
+
+    struct PairStat
+    {
+        uint64_t count = 0;
+        uint32_t initialBegin = 0, initialEnd = 0; // slice of initialPositions
+        vector<uint32_t> positions;                // occurrences created by later merges
+        uint32_t touchedBy = 0xFFFFFFFF;           // last merge that created an occurrence
+    };
+
+    // Pairs of two byte-sized symbols live in a flat table, all others in a hash map
+    vector<PairStat> dense(65536);
+    unordered_map<uint64_t, PairStat> sparse;
+    auto pairKey = [](uint32_t a, uint32_t b) { return ((uint64_t)a << 32) | b; };
+    auto findStat = [&](uint64_t key) -> PairStat *
+    {
+        uint32_t a = (uint32_t)(key >> 32), b = (uint32_t)key;
+        if (a < 256 && b < 256)
+            return &dense[(a << 8) | b];
+        auto it = sparse.find(key);
+        return it == sparse.end() ? nullptr : &it->second;
+    };
+    auto statFor = [&](uint64_t key) -> PairStat &
+    {
+        uint32_t a = (uint32_t)(key >> 32), b = (uint32_t)key;
+        if (a < 256 && b < 256)
+            return dense[(a << 8) | b];
+        return sparse[key];
+    };
+
+    // 1. Count the starting pairs and bucket their positions with a counting sort
+    for (size_t i = 0; i + 1 < n; ++i)
+    {
+        if (symbols[i] == BPE_BOUNDARY || symbols[i + 1] == BPE_BOUNDARY)
+            continue;
+        if (symbols[i] < 256 && symbols[i + 1] < 256)
+            dense[(symbols[i] << 8) | symbols[i + 1]].count++;
+        else
+        {
+            PairStat &stat = sparse[pairKey(symbols[i], symbols[i + 1])];
+            stat.count++;
+            stat.positions.push_back((uint32_t)i);
+        }
+    }
+
+    uint32_t offset = 0;
+    for (PairStat &stat : dense)
+    {
+        stat.initialBegin = stat.initialEnd = offset;
+        offset += (uint32_t)stat.count;
+    }
+
+    vector<uint32_t> initialPositions(offset);
+    for (size_t i = 0; i + 1 < n; ++i)
+    {
+        if (symbols[i] < 256 && symbols[i + 1] < 256)
+            initialPositions[dense[(symbols[i] << 8) | symbols[i + 1]].initialEnd++] = (uint32_t)i;
+    }
+
+    priority_queue<pair<uint64_t, uint64_t>> queue;
+    for (uint32_t d = 0; d < dense.size(); ++d)
+    {
+        if (dense[d].count >= minCount)
+            queue.push({dense[d].count, pairKey(d >> 8, d & 0xFF)});
+    }
+    for (const auto &[key, stat] : sparse)
+    {
+        if (stat.count >= minCount)
+            queue.push({stat.count, key});
+    }
+
+    auto decrement = [&](uint64_t key)
+    {
+        PairStat *stat = findStat(key);
+        if (stat && stat->count > 0)
+            stat->count--;
+    };
+
+    // 2. Merge the most frequent pair until none is frequent enough
+    uint32_t nextSymbol = firstSymbol;
+    vector<uint32_t> positions;
+    vector<uint64_t> touched;
+
+    while (merges.size() < maxMerges && !queue.empty())
+    {
+        auto [count, key] = queue.top();
+        queue.pop();
+
+        PairStat *stat = findStat(key);
+        if (!stat || stat->count == 0)
+            continue;
+        if (stat->count != count)
+        {
+            if (stat->count >= minCount)
+                queue.push({stat->count, key});
+            continue;
+        }
+
+        // Take the pair's occurrences (some may be stale) and retire it
+        // The counting sort left the starting positions in order, so only the later ones need sorting
+        positions.assign(initialPositions.begin() + stat->initialBegin, initialPositions.begin() + stat->initialEnd);
+        size_t sortedPart = positions.size();
+        positions.insert(positions.end(), stat->positions.begin(), stat->positions.end());
+        sort(positions.begin() + sortedPart, positions.end());
+        inplace_merge(positions.begin(), positions.begin() + sortedPart, positions.end());
+        stat->count = 0;
+        stat->initialBegin = stat->initialEnd = 0;
+        vector<uint32_t>().swap(stat->positions);
+
+        // Replace left to right, so overlapping runs like "aaa" merge once
+        uint32_t a = (uint32_t)(key >> 32), b = (uint32_t)key;
+        uint32_t c = nextSymbol;
+        size_t replaced = 0;
+        touched.clear();
+        for (uint32_t p : positions)
+        {
+            uint32_t q = next[p];
+            if (symbols[p] != a || q == NONE || symbols[q] != b)
+                continue;
+
+            // Pairs across a boundary are never counted
+            uint32_t pp = prev[p], nq = next[q];
+            bool hasLeft = pp != NONE && symbols[pp] != BPE_BOUNDARY;
+            bool hasRight = nq != NONE && symbols[nq] != BPE_BOUNDARY;
+            if (hasLeft && pairKey(symbols[pp], a) != key)
+                decrement(pairKey(symbols[pp], a));
+            if (hasRight && pairKey(b, symbols[nq]) != key)
+                decrement(pairKey(b, symbols[nq]));
+
+            symbols[p] = c;
+            symbols[q] = NONE;
+            next[p] = nq;
+            if (nq != NONE)
+                prev[nq] = p;
+
+            if (hasLeft)
+            {
+                uint64_t left = pairKey(symbols[pp], c);
+                PairStat &created = statFor(left);
+                created.count++;
+                created.positions.push_back(pp);
+                if (created.touchedBy != c)
+                {
+                    created.touchedBy = c;
+                    touched.push_back(left);
+                }
+            }
+            if (hasRight)
+            {
+                uint64_t right = pairKey(c, symbols[nq]);
+                PairStat &created = statFor(right);
+                created.count++;
+                created.positions.push_back(p);
+                if (created.touchedBy != c)
+                {
+                    created.touchedBy = c;
+                    touched.push_back(right);
+                }
+            }
+            replaced++;
+        }
+
+        if (replaced == 0)
+            continue;
+
+        merges.push_back({a, b});
+        nextSymbol++;
+
+        // Only pairs containing the new symbol can have grown
+        for (uint64_t t : touched)
+        {
+            PairStat *found = findStat(t);
+            if (found && found->count >= minCount)
+                queue.push({found->count, t});
+        }
+    }
+
+    symbols.erase(remove(symbols.begin(), symbols.end(), NONE), symbols.end());
+}
+
+static vector<uint32_t> bytesToSymbols(const string &text)
+{
+    vector<uint32_t> symbols(text.size());
+    for (size_t i = 0; i < text.size(); ++i)
+        symbols[i] = (unsigned char)text[i];
+    return symbols;
+}
+
+// Byte mode: up to 128 merges numbered 128..255, each stored as a (first, second) byte pair
+static string encodeByteStream(const string &text)
+{
+    vector<uint32_t> symbols = bytesToSymbols(text);
+    vector<pair<uint32_t, uint32_t>> merges;
+    learnBPEMerges(symbols, BPE_FIRST_SYMBOL, 256 - BPE_FIRST_SYMBOL, 2, merges);
+
+    string result(WIDE_BPE_MAGIC, 4);
+    result += (char)WIDE_BPE_VERSION;
+    result += (char)WIDE_BPE_MODE_BYTE;
+    result += string(2, '\0');
+    putU32(result, (uint32_t)merges.size());
+    putU64(result, text.size());
+
+    for (const auto &merge : merges)
+    {
+        result += (char)merge.first;
+        result += (char)merge.second;
+    }
+
+    for (uint32_t symbol : symbols)
+        result += (char)symbol;
+
+    return result;
+}
+
+// Wide mode: literals are ordinary table entries and merges are numbered from 256,
+// then every symbol is renumbered by how often it is used so the most common
+// ones get the one-byte codes.
+static string encodeWideStream(const string &text)
+{
+    vector<uint32_t> symbols = bytesToSymbols(text);
+    vector<pair<uint32_t, uint32_t>> merges;
+    learnBPEMerges(symbols, 256, WIDE_BPE_MAX_SYMBOLS - 256, WIDE_BPE_MIN_PAIR_COUNT, merges);
+
+    vector<uint64_t> uses(256 + merges.size(), 0);
+    for (uint32_t symbol : symbols)
+        uses[symbol]++;
+
+    vector<bool> usedByte(256, false);
+    for (unsigned char c : text)
+        usedByte[c] = true;
+
+    vector<uint32_t> order;
+    for (uint32_t byte = 0; byte < 256; ++byte)
+    {
+        if (usedByte[byte])
+            order.push_back(byte);
+    }
+    for (size_t m = 0; m < merges.size(); ++m)
+        order.push_back((uint32_t)(256 + m));
+
+    stable_sort(order.begin(), order.end(), [&](uint32_t x, uint32_t y) { return uses[x] > uses[y]; });
+
+    vector<uint32_t> code(256 + merges.size(), 0);
+    for (size_t c = 0; c < order.size(); ++c)
+        code[order[c]] = (uint32_t)c;
+
+    string result(WIDE_BPE_MAGIC, 4);
+    result += (char)WIDE_BPE_VERSION;
+    result += (char)WIDE_BPE_MODE;
+    result += string(2, '\0');
+    putU32(result, (uint32_t)order.size());
+    putU64(result, text.size());
+
+    for (uint32_t symbol : order)
+    {
+        uint32_t first = WIDE_BPE_LITERAL, second = symbol;
+        if (symbol >= 256)
+        {
+            first = code[merges[symbol - 256].first];
+            second = code[merges[symbol - 256].second];
+        }
+        result += (char)(first & 0xFF);
+        result += (char)(first >> 8);
+        result += (char)(second & 0xFF);
+        result += (char)(second >> 8);
+    }
+
+    for (uint32_t symbol : symbols)
+    {
+        uint32_t c = code[symbol];
+        if (c < 0x80)
+        {
+            result += (char)c;
+        }
+        else
+        {
+            result += (char)(0x80 | (c >> 8));
+            result += (char)(c & 0xFF);
+        }
+    }
+
+    return result;
+}
+
+string encodeBPEStream(const string &text, bool wide)
+{
+    // Byte mode would read raw bytes >= 128 back as dictionary symbols
+    if (wide || needsWideSymbols(text))
+        return encodeWideStream(text);
+
+    return encodeByteStream(text);
+}
+
+// ==================== Stream Parsing ====================
+
+// Byte-mode table of dict_size (first, second) byte pairs, followed by the symbol data
+static bool parseByteTable(const unsigned char *bytes, size_t size, size_t dict_size, BPEStream &stream)
+{
+    if (dict_size > 256 - BPE_FIRST_SYMBOL || size < dict_size * 2)
+    {
+        cerr << "Error: Corrupt dictionary header (" << dict_size << " entries)" << endl;
+        return false;
+    }
+
+    // Every byte value is a symbol: 128 + i is dictionary entry i, the rest are literals
+    stream.wide = false;
+    stream.symbols.resize(256);
+    for (unsigned int symbol = 0; symbol < 256; ++symbol)
+    {
+        size_t index = symbol - BPE_FIRST_SYMBOL;
+        if (symbol >= BPE_FIRST_SYMBOL && index < dict_size)
+            stream.symbols[symbol] = {false, 0, bytes[2 * index], bytes[2 * index + 1]};
+        else
+            stream.symbols[symbol] = {true, (unsigned char)symbol, 0, 0};
+    }
+
+    stream.data = bytes + dict_size * 2;
+    stream.dataSize = size - dict_size * 2;
+    return true;
+}
+
+// Mode 2 streams keep their table in a shared dictionary and only name it by id
+static bool parseSharedStream(const unsigned char *bytes, size_t size, BPEStream &stream)
+{
+    uint64_t id = getU64(bytes + WIDE_BPE_HEADER_SIZE);
+    const SharedDictionary *dictionary = findSharedDictionary(id);
+    if (!dictionary)
+    {
+        cerr << "Error: Stream needs shared dictionary " << hex << id << dec << "; pass it with -d" << endl;
+        return false;
+    }
+    if (getU32(bytes + 8) != dictionary->symbols.size())
+    {
+        cerr << "Error: Stream does not match shared dictionary " << hex << id << dec << endl;
+        return false;
+    }
+
+    stream.wide = true;
+    stream.symbols = dictionary->symbols;
+    stream.data = bytes + SHARED_BPE_HEADER_SIZE;
+    stream.dataSize = size - SHARED_BPE_HEADER_SIZE;
+    return true;
+}
+
+static bool parseWideStream(const unsigned char *bytes, size_t size, BPEStream &stream)
+{
+    if (size >= SHARED_BPE_HEADER_SIZE && bytes[4] == WIDE_BPE_VERSION && bytes[5] == WIDE_BPE_MODE_SHARED)
+        return parseSharedStream(bytes, size, stream);
+
+    if (size >= WIDE_BPE_HEADER_SIZE && bytes[4] == WIDE_BPE_VERSION && bytes[5] == WIDE_BPE_MODE_BYTE)
+        return parseByteTable(bytes + WIDE_BPE_HEADER_SIZE, size - WIDE_BPE_HEADER_SIZE,
+                              getU32(bytes + 8), stream);
+
+    if (size < WIDE_BPE_HEADER_SIZE || bytes[4] != WIDE_BPE_VERSION || bytes[5] != WIDE_BPE_MODE)
+    {
+        cerr << "Error: Unsupported wide-symbol stream version" << endl;
+        return false;
+    }
+
+    uint32_t tableSize = getU32(bytes + 8);
+    if (tableSize > WIDE_BPE_MAX_SYMBOLS || (size - WIDE_BPE_HEADER_SIZE) / 4 < tableSize)
+    {
+        cerr << "Error: Corrupt symbol table header (" << tableSize << " entries)" << endl;
+        return false;
+    }
+
+    const unsigned char *table = bytes + WIDE_BPE_HEADER_SIZE;
+    stream.wide = true;
+    stream.symbols.resize(tableSize);
+    for (uint32_t i = 0; i < tableSize; ++i)
+    {
+        uint32_t first = table[4 * i] | (table[4 * i + 1] << 8);
+        uint32_t second = table[4 * i + 2] | (table[4 * i + 3] << 8);
+
+        if (first == WIDE_BPE_LITERAL && second < 256)
+        {
+            stream.symbols[i] = {true, (unsigned char)second, 0, 0};
+        }
+        else if (first < tableSize && second < tableSize)
+        {
+            stream.symbols[i] = {false, 0, first, second};
+        }
+        else
+        {
+            cerr << "Error: Corrupt symbol table entry " << i << endl;
+            return false;
+        }
+    }
+
+    stream.data = table + 4 * (size_t)tableSize;
+    stream.dataSize = size - WIDE_BPE_HEADER_SIZE - 4 * (size_t)tableSize;
+    return true;
+}
+
+bool parseBPEStream(const unsigned char *bytes, size_t size, BPEStream &stream)
+{
+    if (size >= 4 && memcmp(bytes, WIDE_BPE_MAGIC, 4) == 0)
+        return parseWideStream(bytes, size, stream);
+
+    // Files written before the XBPE byte mode: host size_t dictionary count,
+    // (first, second) byte pairs, symbol data
+    size_t dict_size;
+    if (size < sizeof(dict_size))
+    {
+        cerr << "Error: Failed to read dictionary size. Input too short?" << endl;
+        return false;
+    }
+    memcpy(&dict_size, bytes, sizeof(dict_size));
+
+    return parseByteTable(bytes + sizeof(dict_size), size - sizeof(dict_size), dict_size, stream);
+}
+
+bool parseBPEStream(const string &comp, BPEStream &stream)
+{
+    return parseBPEStream((const unsigned char *)comp.data(), comp.size(), stream);
+}
+
+// Measures every symbol and expands the short ones, the ones they are made of first.
+// Wide tables can nest thousands of levels deep, so this walks an explicit stack
+// instead of recursing.
+bool buildExpansionTable(const BPEStream &stream, BPEExpansionTable &table)
+{
+    size_t count = stream.symbols.size();
+    table.length.assign(count, 0);
+    table.text.assign(count, "");
+
+    // 0 = not expanded yet, 1 = waiting for its halves, 2 = done
+    vector<char> state(count, 0);
+    vector<uint32_t> pending;
+
+    for (uint32_t root = 0; root < count; ++root)
+    {
+        if (state[root] == 2)
+            continue;
+
+        pending.push_back(root);
+        while (!pending.empty())
+        {
+            uint32_t symbol = pending.back();
+            const BPESymbol &entry = stream.symbols[symbol];
+
+            if (state[symbol] == 2)
+            {
+                pending.pop_back();
+            }
+            else if (entry.literal)
+            {
+                table.text[symbol] = string(1, (char)entry.byte);
+                table.length[symbol] = 1;
+                state[symbol] = 2;
+                pending.pop_back();
+            }
+            else if (state[symbol] == 0)
+            {
+                state[symbol] = 1;
+                for (uint32_t half : {entry.second, entry.first})
+                {
+                    // A symbol that (indirectly) contains itself can never be expanded
+                    if (state[half] == 1)
+                    {
+                        cerr << "Error: Dictionary symbol " << symbol << " refers to itself" << endl;
+                        return false;
+                    }
+                    if (state[half] == 0)
+                        pending.push_back(half);
+                }
+            }
+            else
+            {
+                uint64_t length = table.length[entry.first] + table.length[entry.second];
+                if (length > BPE_MAX_EXPANSION)
+                {
+                    cerr << "Error: Dictionary symbol " << symbol << " expands too far" << endl;
+                    return false;
+                }
+
+                table.length[symbol] = length;
+                if (length <= BPE_CACHED_EXPANSION)
+                    table.text[symbol] = table.text[entry.first] + table.text[entry.second];
+                state[symbol] = 2;
+                pending.pop_back();
+            }
+        }
+    }
+
+    return true;
+}
+
+// ==================== Decoding ====================
+
+bool decodeBPEStream(const string &comp, string &text)
+{
+    BPEStream stream;
+    BPEExpansionTable table;
+    if (!parseBPEStream(comp, stream) || !buildExpansionTable(stream, table))
+        return false;
+
+    return expandBPEStream(stream, table, text);
+}
+
+bool expandBPEStream(const BPEStream &stream, const BPEExpansionTable &table, string &output)
+{
+    uint64_t total = 0;
+    uint32_t symbol;
+    for (size_t k = 0; k < stream.dataSize;)
+    {
+        if (!readSymbol(stream, k, symbol))
+        {
+            cerr << "Error: Corrupt symbol data" << endl;
+            return false;
+        }
+        total += table.length[symbol];
+    }
+
+    output.clear();
+    output.reserve(total);
+    for (size_t k = 0; k < stream.dataSize;)
+    {
+        readSymbol(stream, k, symbol);
+        expandSymbol(stream, table, symbol, [&](const char *text, size_t length)
+        {
+            output.append(text, length);
+        });
+    }
+
+    return true;
+}
+
+// Cuts the symbol data into one slice per worker. Wide codes are one or two
+// bytes long, so their cuts are moved forward to the next code boundary.
+static vector<size_t> sliceSymbolData(const BPEStream &stream, int workers)
+{
+    vector<size_t> cuts(workers + 1, stream.dataSize);
+    cuts[0] = 0;
+
+    size_t k = 0;
+    for (int w = 1; w < workers; ++w)
+    {
+        size_t target = stream.dataSize / workers * w;
+        if (!stream.wide)
+        {
+            cuts[w] = target;
+            continue;
+        }
+
+        while (k < target)
+            k += (stream.data[k] >= 0x80) ? 2 : 1;
+        cuts[w] = min(k, stream.dataSize);
+    }
+
+    return cuts;
+}
+
+// Expands a BPE stream on up to threads workers. A stream that is the payload of a
+// checked container is read in place: its dictionary blocks are verified first, and
+// every worker verifies the blocks starting in its slice before sizing that slice.
+static bool expandBPEToFile(const unsigned char *bytes, size_t size, const CheckedPayload *checked,
+                            const string &outputPath, int threads)
+{
+    BPEStream stream;
+    BPEExpansionTable table;
+    if (!parseBPEStream(bytes, size, stream))
+        return false;
+
+    uint64_t dataOffset = stream.data - bytes;
+    uint32_t headBlocks = checked ? checked->blockAtOrAfter(dataOffset) : 0;
+    if (checked)
+    {
+        uint32_t damaged = findDamagedBlock(*checked, 0, headBlocks);
+        if (damaged < headBlocks)
+        {
+            reportDamagedBlock(*checked, damaged);
+            return false;
+        }
+    }
+
+    if (!buildExpansionTable(stream, table))
+        return false;
+
+    int workers = resolveThreadCount(threads);
+    cout << "Decompressing " << stream.dataSize << " bytes of compressed data with "
+         << workers << " threads." << endl;
+
+    vector<size_t> cuts = sliceSymbolData(stream, workers);
+    vector<char> corrupt(workers, 0);
+    vector<uint32_t> damaged(workers, checked ? checked->blocks : 0);
+
+    // 1. Expanded size of each worker's slice of the symbol data
+    vector<uint64_t> sliceOffset(workers + 1, 0);
+    parallelFor(workers, workers, [&](size_t begin, size_t end, int)
+    {
+        for (size_t w = begin; w < end; ++w)
+        {
+            if (checked)
+            {
+                uint32_t first = max(headBlocks, checked->blockAtOrAfter(dataOffset + cuts[w]));
+                uint32_t last = checked->blockAtOrAfter(dataOffset + cuts[w + 1]);
+                uint32_t block = findDamagedBlock(*checked, first, last);
+                if (block < last)
+                    damaged[w] = block;
+            }
+
+            uint64_t size = 0;
+            uint32_t symbol;
+            for (size_t k = cuts[w]; k < cuts[w + 1];)
+            {
+                if (!readSymbol(stream, k, symbol))
+                {
+                    corrupt[w] = 1;
+                    break;
+                }
+                size += table.length[symbol];
+            }
+            sliceOffset[w + 1] = size;
+        }
+    });
+
+    for (uint32_t block : damaged)
+    {
+        if (checked && block < checked->blocks)
+        {
+            reportDamagedBlock(*checked, block);
+            return false;
+        }
+    }
+
+    for (char bad : corrupt)
+    {
+        if (bad)
+        {
+            cerr << "Error: Corrupt symbol data" << endl;
+            return false;
+        }
+    }
+
+    // 2. Prefix sum turns slice sizes into output offsets and the exact total size
+    for (int w = 0; w < workers; ++w)
+        sliceOffset[w + 1] += sliceOffset[w];
+    uint64_t total = sliceOffset[workers];
+
+    MappedOutputFile output;
+    if (!output.open(outputPath, (size_t)total))
+        return false;
+
+    // 3. Every worker expands its slice straight into its part of the file
+    char *out = output.data();
+    parallelFor(workers, workers, [&](size_t begin, size_t end, int)
+    {
+        for (size_t w = begin; w < end; ++w)
+        {
+            char *dest = out + sliceOffset[w];
+            uint32_t symbol;
+            for (size_t k = cuts[w]; k < cuts[w + 1];)
+            {
+                readSymbol(stream, k, symbol);
+                expandSymbol(stream, table, symbol, [&](const char *text, size_t length)
+                {
+                    memcpy(dest, text, length);
+                    dest += length;
+                });
+            }
+        }
+    });
+
+    if (!output.close())
+    {
+        cerr << "Error: Failed to flush output file: " << outputPath << endl;
+        return false;
+    }
+
+    cout << "Decompressed output size is " << total << " bytes." << endl;
+    return true;
+}
+
+// Entropy-coded and structural payloads are decoded as a whole, so all their blocks
+// are verified first; BPE payloads are verified by the expanding workers
+static bool decompressCheckedToFile(const string &comp, const string &outputPath, int threads)
+{
+    CheckedPayload payload;
+    if (!openChecked(comp, payload))
+        return false;
+
+    const unsigned char *bytes = payload.data;
+    size_t size = (size_t)payload.size;
+    if (size >= 4 && memcmp(bytes, ENTROPY_MAGIC, 4) == 0)
+    {
+        string inner;
+        return verifyChecked(payload, threads) && entropyDecode(bytes, size, inner) &&
+               decompressToFile(inner, outputPath, threads);
+    }
+
+    if (size >= 4 && memcmp(bytes, XML_CODEC_MAGIC, 4) == 0)
+    {
+        string xml;
+        return verifyChecked(payload, threads) && decompressStructural(bytes, size, xml, threads) &&
+               writeBinaryToFile(outputPath, xml);
+    }
+
+    return expandBPEToFile(bytes, size, &payload, outputPath, threads);
+}
+
+bool decompressToFile(const string &comp, const string &outputPath, int threads)
+{
+    if (comp.compare(0, 4, ARCHIVE_MAGIC, 4) == 0)
+        return decompressArchiveToFile(comp, outputPath, threads);
+
+    if (comp.compare(0, 4, CHECKED_MAGIC, 4) == 0)
+        return decompressCheckedToFile(comp, outputPath, threads);
+
+    if (comp.compare(0, 4, ENTROPY_MAGIC, 4) == 0)
+    {
+        string inner;
+        return entropyDecode(comp, inner) && decompressToFile(inner, outputPath, threads);
+    }
+
+    // Structural containers decode in parallel; the replay itself is sequential
+    if (comp.compare(0, 4, XML_CODEC_MAGIC, 4) == 0)
+    {
+        string xml;
+        return decompressStructural(comp, xml, threads) && writeBinaryToFile(outputPath, xml);
+    }
+
+    return expandBPEToFile((const unsigned char *)comp.data(), comp.size(), nullptr, outputPath, threads);
+}
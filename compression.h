@@ -0,0 +1,144 @@
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "functions.h"
+
+using namespace std;
+
+// First byte value used as a dictionary symbol by the byte-mode format
+const unsigned int BPE_FIRST_SYMBOL = 128;
+
+// Wide-symbol format: "XBPE", u8 version, u8 mode, u16 reserved, u32 table size,
+// u64 original size, table entries (u16 first, u16 second), symbol codes.
+// Codes below 0x80 take one byte, the others two bytes (0x80 | high bits, low byte),
+// so no raw byte is ever mistaken for a dictionary code.
+const char WIDE_BPE_MAGIC[4] = {'X', 'B', 'P', 'E'};
+const unsigned char WIDE_BPE_VERSION = 1;
+const unsigned char WIDE_BPE_MODE = 1;
+const size_t WIDE_BPE_HEADER_SIZE = 20;
+const uint32_t WIDE_BPE_MAX_SYMBOLS = 0x8000;
+
+// Byte mode in the same header: the table size is the number of merges (at most 128),
+// stored as (first, second) byte pairs, and every symbol code is one byte.
+// Older files start with a host size_t merge count instead and are still read.
+const unsigned char WIDE_BPE_MODE_BYTE = 0;
+
+// Table entries whose first half is this value stand for the literal byte in the second half
+const uint16_t WIDE_BPE_LITERAL = 0xFFFF;
+
+// A merge only pays for its 4-byte table entry if the pair occurs this often
+const uint32_t WIDE_BPE_MIN_PAIR_COUNT = 4;
+
+// Streams whose table lives in a shared dictionary file (see dictionary.h):
+// the 20-byte header is followed by the u64 dictionary id, then the symbol codes
+const unsigned char WIDE_BPE_MODE_SHARED = 2;
+const size_t SHARED_BPE_HEADER_SIZE = WIDE_BPE_HEADER_SIZE + 8;
+
+// learnBPEMerges never pairs this symbol with its neighbours; it separates training samples
+const uint32_t BPE_BOUNDARY = 0xFFFFFFFE;
+
+// One entry of a symbol table: a literal byte or a pair of other symbols
+struct BPESymbol
+{
+    bool literal;
+    unsigned char byte;
+    uint32_t first;
+    uint32_t second;
+};
+
+// A .comp stream split into its symbol table and its symbol codes.
+// data points into the string the stream was parsed from.
+struct BPEStream
+{
+    bool wide = false;
+    vector<BPESymbol> symbols;
+    const unsigned char *data = nullptr;
+    size_t dataSize = 0;
+};
+
+// Symbols up to this many bytes keep their whole expansion in memory; longer ones
+// (repetitive input builds symbols of many kilobytes) are rebuilt from their halves
+const uint64_t BPE_CACHED_EXPANSION = 1024;
+
+// Longest expansion a stream may declare
+const uint64_t BPE_MAX_EXPANSION = 1ull << 40;
+
+// Expanded length of every symbol, and the text of the short ones
+struct BPEExpansionTable
+{
+    vector<uint64_t> length;
+    vector<string> text;
+};
+
+// --- Little-endian fields for the on-disk formats ---
+void putU32(string &out, uint32_t value);
+void putU64(string &out, uint64_t value);
+uint32_t getU32(const unsigned char *bytes);
+uint64_t getU64(const unsigned char *bytes);
+
+// LEB128: 7 bits per byte, high bit set on every byte but the last
+void putVarint(string &out, uint64_t value);
+bool getVarint(const unsigned char *&p, const unsigned char *end, uint64_t &value);
+
+// --- Encoding ---
+bool needsWideSymbols(const string &text);
+void learnBPEMerges(vector<uint32_t> &symbols, uint32_t firstSymbol, size_t maxMerges,
+                    uint32_t minCount, vector<pair<uint32_t, uint32_t>> &merges);
+string encodeBPEStream(const string &text, bool wide = false);
+
+// --- Stream Parsing ---
+// The stream keeps pointing into bytes, which must outlive it
+bool parseBPEStream(const unsigned char *bytes, size_t size, BPEStream &stream);
+bool parseBPEStream(const string &comp, BPEStream &stream);
+bool buildExpansionTable(const BPEStream &stream, BPEExpansionTable &table);
+
+// --- Decoding ---
+
+// Reads the symbol code at data[k] and moves k past it; false if it is cut off or unknown
+inline bool readSymbol(const BPEStream &stream, size_t &k, uint32_t &symbol)
+{
+    symbol = stream.data[k++];
+    if (stream.wide && symbol >= 0x80)
+    {
+        if (k >= stream.dataSize)
+            return false;
+        symbol = ((symbol & 0x7F) << 8) | stream.data[k++];
+    }
+    return symbol < stream.symbols.size();
+}
+
+// Calls emit(text, length) for consecutive pieces of the symbol's expansion
+template <class Emit>
+void expandSymbol(const BPEStream &stream, const BPEExpansionTable &table, uint32_t symbol, Emit emit)
+{
+    if (table.length[symbol] <= BPE_CACHED_EXPANSION)
+    {
+        emit(table.text[symbol].data(), table.text[symbol].size());
+        return;
+    }
+
+    thread_local vector<uint32_t> pending;
+    pending.assign(1, symbol);
+    while (!pending.empty())
+    {
+        uint32_t top = pending.back();
+        pending.pop_back();
+        if (table.length[top] <= BPE_CACHED_EXPANSION)
+            emit(table.text[top].data(), table.text[top].size());
+        else
+        {
+            pending.push_back(stream.symbols[top].second);
+            pending.push_back(stream.symbols[top].first);
+        }
+    }
+}
+
+bool decodeBPEStream(const string &comp, string &text);
+bool expandBPEStream(const BPEStream &stream, const BPEExpansionTable &table, string &output);
+bool decompressToFile(const string &comp, const string &outputPath, int threads);
+
+#endif
@@ -0,0 +1,306 @@
+#include "dictionary.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <map>
+#include <queue>
+
+using namespace std;
+
+// Dictionaries loaded with -d, by id
+static map<uint64_t, SharedDictionary> loaded_Dictionaries;
+static const SharedDictionary *current_Dictionary = nullptr;
+
+const uint16_t DICTIONARY_NO_RANK = 0xFFFF;
+
+// FNV-1a over the table, so the same dictionary always gets the same id
+static uint64_t dictionaryId(const unsigned char *bytes, size_t size)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static void putU16(string &out, uint32_t value)
+{
+    out += (char)(value & 0xFF);
+    out += (char)((value >> 8) & 0xFF);
+}
+
+// ==================== Training ====================
+
+bool readTrainingSamples(const string &inputs, vector<string> &samples)
+{
+    vector<string> paths;
+    error_code error;
+    if (filesystem::is_directory(inputs, error))
+    {
+        for (const auto &entry : filesystem::directory_iterator(inputs, error))
+        {
+            if (entry.is_regular_file())
+                paths.push_back(entry.path().string());
+        }
+        sort(paths.begin(), paths.end());
+    }
+    else
+    {
+        size_t start = 0;
+        while (start <= inputs.size())
+        {
+            size_t comma = inputs.find(',', start);
+            if (comma == string::npos)
+                comma = inputs.size();
+            if (comma > start)
+                paths.push_back(inputs.substr(start, comma - start));
+            start = comma + 1;
+        }
+    }
+
+    if (paths.empty())
+    {
+        cerr << "Error: No training documents in " << inputs << endl;
+        return false;
+    }
+
+    for (const string &path : paths)
+    {
+        string sample;
+        if (!extract_binary_content(path, sample))
+            return false;
+        samples.push_back(move(sample));
+    }
+    return true;
+}
+
+string trainSharedDictionary(const vector<string> &samples)
+{
+    // One sequence for all samples, with a boundary so no merge spans two of them
+    vector<uint32_t> symbols;
+    for (const string &sample : samples)
+    {
+        for (unsigned char c : sample)
+            symbols.push_back(c);
+        symbols.push_back(BPE_BOUNDARY);
+    }
+
+    vector<pair<uint32_t, uint32_t>> merges;
+    learnBPEMerges(symbols, 256, WIDE_BPE_MAX_SYMBOLS - 256, WIDE_BPE_MIN_PAIR_COUNT, merges);
+
+    // Most used symbols get the one-byte codes, as in wide streams
+    vector<uint64_t> uses(256 + merges.size(), 0);
+    for (uint32_t symbol : symbols)
+    {
+        if (symbol != BPE_BOUNDARY)
+            uses[symbol]++;
+    }
+
+    vector<uint32_t> order(256 + merges.size());
+    for (uint32_t symbol = 0; symbol < order.size(); ++symbol)
+        order[symbol] = symbol;
+    stable_sort(order.begin(), order.end(), [&](uint32_t x, uint32_t y) { return uses[x] > uses[y]; });
+
+    vector<uint32_t> code(order.size());
+    for (size_t c = 0; c < order.size(); ++c)
+        code[order[c]] = (uint32_t)c;
+
+    string table;
+    for (uint32_t symbol : order)
+    {
+        if (symbol < 256)
+        {
+            putU16(table, WIDE_BPE_LITERAL);
+            putU16(table, symbol);
+        }
+        else
+        {
+            putU16(table, code[merges[symbol - 256].first]);
+            putU16(table, code[merges[symbol - 256].second]);
+        }
+    }
+    for (uint32_t symbol : order)
+        putU16(table, symbol < 256 ? DICTIONARY_NO_RANK : symbol - 256);
+
+    string result(DICTIONARY_MAGIC, 4);
+    result += (char)DICTIONARY_VERSION;
+    result += string(3, '\0');
+    putU32(result, (uint32_t)order.size());
+    putU64(result, dictionaryId((const unsigned char *)table.data(), table.size()));
+    result += table;
+
+    cout << "Trained a dictionary of " << merges.size() << " merges from "
+         << samples.size() << " samples." << endl;
+    return result;
+}
+
+// ==================== Loading ====================
+
+bool loadSharedDictionary(const string &path)
+{
+    string file;
+    if (!extract_binary_content(path, file))
+        return false;
+
+    const unsigned char *bytes = (const unsigned char *)file.data();
+    if (file.size() < DICTIONARY_HEADER_SIZE || memcmp(bytes, DICTIONARY_MAGIC, 4) != 0 ||
+        bytes[4] != DICTIONARY_VERSION)
+    {
+        cerr << "Error: " << path << " is not a dictionary file" << endl;
+        return false;
+    }
+
+    uint32_t tableSize = getU32(bytes + 8);
+    if (tableSize < 256 || tableSize > WIDE_BPE_MAX_SYMBOLS ||
+        file.size() != DICTIONARY_HEADER_SIZE + 6 * (size_t)tableSize)
+    {
+        cerr << "Error: Corrupt dictionary header in " << path << endl;
+        return false;
+    }
+
+    SharedDictionary dictionary;
+    dictionary.id = getU64(bytes + 12);
+    dictionary.symbols.resize(tableSize);
+    dictionary.rank.resize(tableSize);
+    fill(begin(dictionary.literalCode), end(dictionary.literalCode), WIDE_BPE_MAX_SYMBOLS);
+
+    const unsigned char *table = bytes + DICTIONARY_HEADER_SIZE;
+    const unsigned char *ranks = table + 4 * (size_t)tableSize;
+    for (uint32_t i = 0; i < tableSize; ++i)
+    {
+        uint32_t first = table[4 * i] | (table[4 * i + 1] << 8);
+        uint32_t second = table[4 * i + 2] | (table[4 * i + 3] << 8);
+        dictionary.rank[i] = ranks[2 * i] | (ranks[2 * i + 1] << 8);
+
+        if (first == WIDE_BPE_LITERAL && second < 256)
+        {
+            dictionary.symbols[i] = {true, (unsigned char)second, 0, 0};
+            dictionary.literalCode[second] = i;
+        }
+        else if (first < tableSize && second < tableSize)
+        {
+            dictionary.symbols[i] = {false, 0, first, second};
+            dictionary.merges[((uint64_t)first << 32) | second] = {dictionary.rank[i], i};
+        }
+        else
+        {
+            cerr << "Error: Corrupt dictionary entry " << i << " in " << path << endl;
+            return false;
+        }
+    }
+
+    for (uint32_t byte = 0; byte < 256; ++byte)
+    {
+        if (dictionary.literalCode[byte] == WIDE_BPE_MAX_SYMBOLS)
+        {
+            cerr << "Error: Dictionary " << path << " has no code for byte " << byte << endl;
+            return false;
+        }
+    }
+
+    uint64_t id = dictionary.id;
+    loaded_Dictionaries[id] = move(dictionary);
+    current_Dictionary = &loaded_Dictionaries[id];
+
+    cout << "Loaded dictionary " << hex << id << dec << " (" << tableSize << " symbols)." << endl;
+    return true;
+}
+
+const SharedDictionary *currentSharedDictionary()
+{
+    return current_Dictionary;
+}
+
+const SharedDictionary *findSharedDictionary(uint64_t id)
+{
+    auto found = loaded_Dictionaries.find(id);
+    return found == loaded_Dictionaries.end() ? nullptr : &found->second;
+}
+
+// ==================== Encoding ====================
+
+// Applies the dictionary's merges without learning: the adjacent pair with the
+// lowest rank is merged first, like replaying the training merges in order,
+// but in one pass driven by a min-heap of (rank, position)
+string encodeWithSharedDictionary(const string &text, const SharedDictionary &dictionary)
+{
+    const uint32_t NONE = 0xFFFFFFFF;
+    size_t n = text.size();
+    vector<uint32_t> symbols(n), prev(n), next(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        symbols[i] = dictionary.literalCode[(unsigned char)text[i]];
+        prev[i] = i == 0 ? NONE : (uint32_t)(i - 1);
+        next[i] = i + 1 == n ? NONE : (uint32_t)(i + 1);
+    }
+
+    auto findMerge = [&](uint32_t p) -> const pair<uint32_t, uint32_t> *
+    {
+        if (p == NONE || next[p] == NONE)
+            return nullptr;
+        auto found = dictionary.merges.find(((uint64_t)symbols[p] << 32) | symbols[next[p]]);
+        return found == dictionary.merges.end() ? nullptr : &found->second;
+    };
+
+    // Ties go to the leftmost position, so runs like "aaa" merge left to right
+    priority_queue<uint64_t, vector<uint64_t>, greater<uint64_t>> queue;
+    auto push = [&](uint32_t p)
+    {
+        if (const auto *merge = findMerge(p))
+            queue.push(((uint64_t)merge->first << 32) | p);
+    };
+    for (size_t i = 0; i + 1 < n; ++i)
+        push((uint32_t)i);
+
+    while (!queue.empty())
+    {
+        uint64_t top = queue.top();
+        queue.pop();
+        uint32_t rank = (uint32_t)(top >> 32), p = (uint32_t)top;
+
+        // Skip entries whose pair was changed by an earlier merge
+        if (symbols[p] == NONE)
+            continue;
+        const auto *merge = findMerge(p);
+        if (!merge || merge->first != rank)
+            continue;
+
+        uint32_t q = next[p];
+        symbols[p] = merge->second;
+        symbols[q] = NONE;
+        next[p] = next[q];
+        if (next[q] != NONE)
+            prev[next[q]] = p;
+
+        push(prev[p]);
+        push(p);
+    }
+
+    string result(WIDE_BPE_MAGIC, 4);
+    result += (char)WIDE_BPE_VERSION;
+    result += (char)WIDE_BPE_MODE_SHARED;
+    result += string(2, '\0');
+    putU32(result, (uint32_t)dictionary.symbols.size());
+    putU64(result, n);
+    putU64(result, dictionary.id);
+
+    for (uint32_t c : symbols)
+    {
+        if (c == NONE)
+            continue;
+        if (c < 0x80)
+        {
+            result += (char)c;
+        }
+        else
+        {
+            result += (char)(0x80 | (c >> 8));
+            result += (char)(c & 0xFF);
+        }
+    }
+
+    return result;
+}
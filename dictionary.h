@@ -0,0 +1,52 @@
+#ifndef DICTIONARY_H
+#define DICTIONARY_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+#include "compression.h"
+
+using namespace std;
+
+// Shared dictionary (.xdct): a wide symbol table learned once from sample documents,
+// so small files neither learn nor store their own. Streams compressed with it
+// (XBPE mode 2) only carry the dictionary id.
+//
+// Layout (all fields little-endian):
+//   "XDCT", u8 version, 3 reserved bytes, u32 table size, u64 id,
+//   table entries (u16 first, u16 second) in code order, like a wide stream,
+//   then one u16 merge rank per entry (0xFFFF for literals).
+// All 256 byte values are in the table, so any input can be encoded.
+const char DICTIONARY_MAGIC[4] = {'X', 'D', 'C', 'T'};
+const unsigned char DICTIONARY_VERSION = 1;
+const size_t DICTIONARY_HEADER_SIZE = 20;
+
+struct SharedDictionary
+{
+    uint64_t id = 0;
+    vector<BPESymbol> symbols;   // indexed by code
+    uint32_t literalCode[256];   // code of every byte value
+    vector<uint16_t> rank;       // order the merges were learned in
+
+    // (first code, second code) -> (rank, merged code)
+    unordered_map<uint64_t, pair<uint32_t, uint32_t>> merges;
+};
+
+// Reads the training documents: a comma-separated list of files, or a directory
+// (every regular file in it, in name order)
+bool readTrainingSamples(const string &inputs, vector<string> &samples);
+
+// Learns a dictionary from the samples and returns the dictionary file content
+string trainSharedDictionary(const vector<string> &samples);
+
+// Loads a dictionary file; it is then used by compress() and found by id when
+// decoding. Several dictionaries can be loaded at once.
+bool loadSharedDictionary(const string &path);
+const SharedDictionary *currentSharedDictionary();
+const SharedDictionary *findSharedDictionary(uint64_t id);
+
+string encodeWithSharedDictionary(const string &text, const SharedDictionary &dictionary);
+
+#endif
@@ -0,0 +1,310 @@
+#include "entropy.h"
+#include "compression.h"
+
+#include <queue>
+
+using namespace std;
+
+// ==================== Code Lengths ====================
+
+// Huffman code lengths, then limited to HUFFMAN_MAX_CODE_LENGTH by lengthening
+// the rarest short codes until the Kraft sum fits again
+static void buildCodeLengths(const uint64_t freq[256], unsigned char lengths[256])
+{
+    struct Node
+    {
+        uint64_t weight;
+        int left, right;
+    };
+    vector<Node> nodes;
+    priority_queue<pair<uint64_t, int>, vector<pair<uint64_t, int>>, greater<pair<uint64_t, int>>> heap;
+
+    for (int s = 0; s < 256; ++s)
+    {
+        lengths[s] = 0;
+        if (freq[s] > 0)
+        {
+            heap.push({freq[s], (int)nodes.size()});
+            nodes.push_back({freq[s], -1, s});
+        }
+    }
+
+    if (nodes.size() == 1)
+    {
+        lengths[nodes[0].right] = 1;
+        return;
+    }
+
+    while (heap.size() > 1)
+    {
+        auto a = heap.top();
+        heap.pop();
+        auto b = heap.top();
+        heap.pop();
+        heap.push({a.first + b.first, (int)nodes.size()});
+        nodes.push_back({a.first + b.first, a.second, b.second});
+    }
+
+    // Depth of every leaf (leaves have left == -1 and keep their symbol in right)
+    vector<int> depth(nodes.size(), 0);
+    for (int n = (int)nodes.size() - 1; n >= 0; --n)
+    {
+        if (nodes[n].left == -1)
+            lengths[nodes[n].right] = (unsigned char)min(depth[n], HUFFMAN_MAX_CODE_LENGTH);
+        else
+        {
+            depth[nodes[n].left] = depth[n] + 1;
+            depth[nodes[n].right] = depth[n] + 1;
+        }
+    }
+
+    // Kraft sum in units of 2^-max
+    const uint32_t capacity = 1u << HUFFMAN_MAX_CODE_LENGTH;
+    uint32_t kraft = 0;
+    vector<int> byFrequency;
+    for (int s = 0; s < 256; ++s)
+    {
+        if (lengths[s] > 0)
+        {
+            kraft += capacity >> lengths[s];
+            byFrequency.push_back(s);
+        }
+    }
+    stable_sort(byFrequency.begin(), byFrequency.end(),
+                [&](int a, int b) { return freq[a] < freq[b]; });
+
+    while (kraft > capacity)
+    {
+        // The rarest symbol whose code can still grow gives up the least
+        for (int s : byFrequency)
+        {
+            if (lengths[s] < HUFFMAN_MAX_CODE_LENGTH)
+            {
+                kraft -= capacity >> (lengths[s] + 1);
+                lengths[s]++;
+                break;
+            }
+        }
+    }
+
+    // Hand leftover code space back to the most frequent symbols
+    for (auto it = byFrequency.rbegin(); it != byFrequency.rend(); ++it)
+    {
+        while (lengths[*it] > 1 && kraft + (capacity >> lengths[*it]) <= capacity)
+        {
+            kraft += capacity >> lengths[*it];
+            lengths[*it]--;
+        }
+    }
+}
+
+// Canonical codes, bit-reversed because the stream is read LSB first
+static void buildCodes(const unsigned char lengths[256], uint32_t codes[256])
+{
+    uint32_t count[HUFFMAN_MAX_CODE_LENGTH + 1] = {0};
+    for (int s = 0; s < 256; ++s)
+        count[lengths[s]]++;
+    count[0] = 0;
+
+    uint32_t next[HUFFMAN_MAX_CODE_LENGTH + 1] = {0};
+    for (int len = 1; len <= HUFFMAN_MAX_CODE_LENGTH; ++len)
+        next[len] = (next[len - 1] + count[len - 1]) << 1;
+
+    for (int s = 0; s < 256; ++s)
+    {
+        codes[s] = 0;
+        if (lengths[s] == 0)
+            continue;
+
+        uint32_t code = next[lengths[s]]++;
+
+        uint32_t reversed = 0;
+        for (int b = 0; b < lengths[s]; ++b)
+            reversed |= ((code >> b) & 1) << (lengths[s] - 1 - b);
+        codes[s] = reversed;
+    }
+}
+
+// ==================== Encoding ====================
+
+string entropyEncode(const string &data)
+{
+    if (data.empty())
+        return "";
+
+    uint64_t freq[256] = {0};
+    for (unsigned char c : data)
+        freq[c]++;
+
+    unsigned char lengths[256];
+    uint32_t codes[256];
+    buildCodeLengths(freq, lengths);
+    buildCodes(lengths, codes);
+
+    string bits;
+    bits.reserve(data.size());
+    uint64_t buffer = 0;
+    int filled = 0;
+    for (unsigned char c : data)
+    {
+        buffer |= (uint64_t)codes[c] << filled;
+        filled += lengths[c];
+        if (filled >= 32)
+        {
+            putU32(bits, (uint32_t)buffer);
+            buffer >>= 32;
+            filled -= 32;
+        }
+    }
+    for (; filled > 0; filled -= 8, buffer >>= 8)
+        bits += (char)(buffer & 0xFF);
+
+    string result(ENTROPY_MAGIC, 4);
+    result += (char)ENTROPY_VERSION;
+    result += string(3, '\0');
+    putU64(result, data.size());
+    putU64(result, bits.size());
+    for (int s = 0; s < 256; s += 2)
+        result += (char)(lengths[s] | (lengths[s + 1] << 4));
+    result += bits;
+    return result;
+}
+
+// ==================== Decoding ====================
+
+// One lookup decodes up to two symbols from the next HUFFMAN_MAX_CODE_LENGTH bits
+struct HuffmanEntry
+{
+    unsigned char symbols[2];
+    uint8_t count; // 0 marks bit patterns no code starts with
+    uint8_t bits;
+};
+
+static void buildDecodeTable(const unsigned char lengths[256], vector<HuffmanEntry> &table)
+{
+    const uint32_t size = 1u << HUFFMAN_MAX_CODE_LENGTH;
+    uint32_t codes[256];
+    buildCodes(lengths, codes);
+
+    vector<HuffmanEntry> single(size, HuffmanEntry{{0, 0}, 0, 0});
+    for (int s = 0; s < 256; ++s)
+    {
+        if (lengths[s] == 0)
+            continue;
+        for (uint32_t index = codes[s]; index < size; index += 1u << lengths[s])
+            single[index] = {{(unsigned char)s, 0}, 1, lengths[s]};
+    }
+
+    // Pair a code with the one after it when both fit in the lookup width
+    table = single;
+    for (uint32_t index = 0; index < size; ++index)
+    {
+        HuffmanEntry &entry = table[index];
+        if (entry.count == 0)
+            continue;
+
+        const HuffmanEntry &second = single[index >> entry.bits];
+        if (second.count == 1 && entry.bits + second.bits <= HUFFMAN_MAX_CODE_LENGTH)
+        {
+            entry.symbols[1] = second.symbols[0];
+            entry.count = 2;
+            entry.bits += second.bits;
+        }
+    }
+}
+
+// The stream is little-endian on every host; compilers turn this into one load
+// where that is the native order
+static inline uint64_t loadLittleEndian64(const unsigned char *p)
+{
+    uint64_t word = 0;
+    for (int k = 7; k >= 0; --k)
+        word = (word << 8) | p[k];
+    return word;
+}
+
+bool entropyDecode(const unsigned char *header, size_t size, string &data)
+{
+    if (size < ENTROPY_HEADER_SIZE || memcmp(header, ENTROPY_MAGIC, 4) != 0 ||
+        header[4] != ENTROPY_VERSION)
+    {
+        cerr << "Error: Unsupported entropy stream version" << endl;
+        return false;
+    }
+
+    uint64_t rawSize = getU64(header + 8);
+    uint64_t streamSize = getU64(header + 16);
+    if (streamSize != size - ENTROPY_HEADER_SIZE || rawSize > streamSize * 8)
+    {
+        cerr << "Error: Corrupt entropy stream header" << endl;
+        return false;
+    }
+
+    unsigned char lengths[256];
+    for (int s = 0; s < 256; s += 2)
+    {
+        lengths[s] = header[24 + s / 2] & 0x0F;
+        lengths[s + 1] = header[24 + s / 2] >> 4;
+        if (lengths[s] > HUFFMAN_MAX_CODE_LENGTH || lengths[s + 1] > HUFFMAN_MAX_CODE_LENGTH)
+        {
+            cerr << "Error: Corrupt Huffman code lengths" << endl;
+            return false;
+        }
+    }
+
+    vector<HuffmanEntry> table;
+    buildDecodeTable(lengths, table);
+
+    const unsigned char *p = header + ENTROPY_HEADER_SIZE;
+    const unsigned char *end = p + streamSize;
+    const uint64_t mask = (1u << HUFFMAN_MAX_CODE_LENGTH) - 1;
+
+    // One spare byte because a pair entry may run one symbol past the end
+    data.assign(rawSize + 1, '\0');
+    char *out = &data[0];
+    char *outEnd = out + rawSize;
+
+    uint64_t buffer = 0;
+    int filled = 0;
+    while (out < outEnd)
+    {
+        // Refill to at least 56 bits; whole words while far from the end
+        if (end - p >= 8)
+        {
+            buffer |= loadLittleEndian64(p) << filled;
+            p += (63 - filled) >> 3;
+            filled |= 56;
+        }
+        else
+        {
+            for (; filled <= 56 && p < end; filled += 8)
+                buffer |= (uint64_t)*p++ << filled;
+            if (p == end)
+                filled = 56; // only zero bits follow the last byte
+        }
+
+        // Four lookups use at most 48 of the bits just loaded
+        for (int k = 0; k < 4 && out < outEnd; ++k)
+        {
+            const HuffmanEntry &entry = table[buffer & mask];
+            if (entry.count == 0)
+            {
+                cerr << "Error: Invalid Huffman code in entropy stream" << endl;
+                return false;
+            }
+            out[0] = (char)entry.symbols[0];
+            out[1] = (char)entry.symbols[1];
+            out += entry.count;
+            buffer >>= entry.bits;
+            filled -= entry.bits;
+        }
+    }
+
+    data.resize(rawSize);
+    return true;
+}
+
+bool entropyDecode(const string &comp, string &data)
+{
+    return entropyDecode((const unsigned char *)comp.data(), comp.size(), data);
+}
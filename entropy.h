@@ -0,0 +1,30 @@
+#ifndef ENTROPY_H
+#define ENTROPY_H
+
+#include <string>
+#include <cstdint>
+
+using namespace std;
+
+// Compression levels (-l): 1 writes the dictionary stream as it is,
+// 2 also Huffman-codes its bytes
+const int COMPRESSION_LEVEL_DICTIONARY = 1;
+const int COMPRESSION_LEVEL_ENTROPY = 2;
+
+// Entropy-coded stream: canonical Huffman over the bytes of any other .comp stream.
+// Layout (all fields little-endian):
+//   "XHUF", u8 version, 3 reserved bytes, u64 decoded size, u64 bit stream bytes,
+//   256 code lengths packed two per byte (low nibble first), bit stream (LSB first).
+const char ENTROPY_MAGIC[4] = {'X', 'H', 'U', 'F'};
+const unsigned char ENTROPY_VERSION = 1;
+const size_t ENTROPY_HEADER_SIZE = 24 + 128;
+
+// Codes are limited so that one table lookup always sees a whole code
+const int HUFFMAN_MAX_CODE_LENGTH = 12;
+
+// Empty result for empty input
+string entropyEncode(const string &data);
+bool entropyDecode(const unsigned char *bytes, size_t size, string &data);
+bool entropyDecode(const string &comp, string &data);
+
+#endif
@@ -1,5 +1,24 @@
 #include "functions.h"
 #include "graph.h"
+#include "compression.h"
+#include "archive.h"
+#include "xml_codec.h"
+#include "entropy.h"
+#include "dictionary.h"
+#include "checksum.h"
+#include "social_index.h"
+#include "compact_graph.h"
+#include "intersection.h"
+#include "recommend.h"
+#include "minhash.h"
+#include "centrality.h"
+#include "communities.h"
+#include "traversal.h"
+#include "triangles.h"
+#include "parallel.h"
+
+#include <queue>
+
 using namespace std;
 
 // ==================== Implement Post class functions ====================
@@ -830,48 +849,87 @@ string mini(const string &xml)
     return output;
 }
 
-string compress(const string &xml)
+string compress(const string &xml, const string &mode, int threads, int level)
 {
-    // Convert string to bytes
-    vector<unsigned char> data = stringToBytes(xml);
-
-    if (data.empty())
+    if (xml.empty())
     {
         cerr << "Error: Empty input for compression" << endl;
         return "";
     }
 
-    // Clear dictionary and perform BPE
-    BPE_DICTIONARY.clear();
-    unsigned char next_free = 128; // Start replacement symbols at 128
+    if (mode != "bpe" && mode != "wide" && mode != "xml")
+    {
+        cerr << "Error: Unknown compression mode '" << mode << "' (expected bpe, wide or xml)" << endl;
+        return "";
+    }
+
+    if (level != COMPRESSION_LEVEL_DICTIONARY && level != COMPRESSION_LEVEL_ENTROPY)
+    {
+        cerr << "Error: Unknown compression level " << level << " (expected 1 or 2)" << endl;
+        return "";
+    }
+
+    string result;
+    if (mode == "xml")
+    {
+        result = compressStructural(xml, threads);
+        if (result.empty())
+        {
+            cout << "Input contains NUL bytes, using plain BPE." << endl;
+        }
+        else if (xml.size() < XML_CODEC_MIN_INPUT)
+        {
+            // Small documents: keep plain BPE when the container directory outweighs the split
+            string plain = encodeBPEStream(xml, needsWideSymbols(xml));
+            if (plain.size() < result.size())
+            {
+                result = move(plain);
+            }
+        }
+    }
 
-    // Loop until no more pairs are found or we run out of free bytes (255)
-    while (oneIterationBPE(data, next_free))
-        ;
+    // A dictionary loaded with -d replaces the per-file symbol table
+    const SharedDictionary *dictionary = currentSharedDictionary();
+    if (result.empty() && dictionary)
+    {
+        result = encodeWithSharedDictionary(xml, *dictionary);
+    }
 
-    // Build binary output
-    stringstream result;
+    // Bytes >= 128 collide with byte-mode dictionary codes, so such input always uses wide symbols
+    if (result.empty())
+    {
+        bool wide = mode == "wide" || needsWideSymbols(xml);
+        if (wide && mode != "wide")
+        {
+            cout << "Input contains bytes >= 128, using wide symbols." << endl;
+        }
 
-    // Write dictionary size (as binary)
-    size_t dict_size = BPE_DICTIONARY.size();
-    result.write(reinterpret_cast<const char *>(&dict_size), sizeof(dict_size));
+        result = encodeBPEStream(xml, wide);
+    }
 
-    // Write dictionary entries (raw bytes)
-    for (const auto &entry : BPE_DICTIONARY)
+    // Huffman-code the dictionary output unless that makes it bigger
+    if (level == COMPRESSION_LEVEL_ENTROPY)
     {
-        result.write(reinterpret_cast<const char *>(&entry.first), sizeof(entry.first));
-        result.write(reinterpret_cast<const char *>(&entry.second), sizeof(entry.second));
+        string coded = entropyEncode(result);
+        if (coded.size() < result.size())
+        {
+            result = move(coded);
+        }
+        else
+        {
+            cout << "Entropy coding does not help this input, keeping level 1 output." << endl;
+        }
     }
 
-    // Write compressed data (raw bytes)
-    result.write(reinterpret_cast<const char *>(data.data()), data.size());
+    // Versioned header and per-block checksums around whatever was produced
+    result = wrapChecked(result);
 
-    size_t total_size = sizeof(dict_size) + (BPE_DICTIONARY.size() * 2) + data.size();
+    size_t total_size = result.size();
     cout << "Compression complete. Original size: " << xml.length()
          << " bytes, Compressed size: " << total_size
          << " bytes (Saved: " << (int)xml.length() - (int)total_size << " bytes)" << endl;
 
-    return result.str();
+    return result;
 }
 
 string decompress(const string &xml)
@@ -886,316 +944,350 @@ string decompress(const string &xml)
     // Print input size to debug "Text Mode" reading issues
     cout << "Debug: Decompress received " << xml.size() << " bytes." << endl;
 
-    stringstream ss(xml);
+    // Checksums are verified before anything is decoded
+    if (xml.compare(0, 4, CHECKED_MAGIC, 4) == 0)
+    {
+        string inner;
+        if (!unwrapChecked(xml, inner, 1))
+        {
+            return "";
+        }
+        return decompress(inner);
+    }
 
-    // 2. Read Dictionary Size
-    size_t dict_size;
-    ss.read(reinterpret_cast<char *>(&dict_size), sizeof(dict_size));
+    // Level 2 output wraps a level 1 stream in Huffman codes
+    if (xml.compare(0, 4, ENTROPY_MAGIC, 4) == 0)
+    {
+        string inner;
+        if (!entropyDecode(xml, inner))
+        {
+            return "";
+        }
+        cout << "Debug: Entropy stage expanded to " << inner.size() << " bytes." << endl;
+        return decompress(inner);
+    }
 
-    if (ss.fail())
+    // Seekable archives hold one BPE stream per block
+    if (xml.compare(0, 4, ARCHIVE_MAGIC, 4) == 0)
     {
-        cerr << "Error: Failed to read dictionary size. Input too short?" << endl;
-        return "";
+        return decompressArchive(xml);
     }
 
-    cout << "Debug: Dictionary size is " << dict_size << " entries." << endl;
+    // Structural streams keep tags and text in separate containers
+    if (xml.compare(0, 4, XML_CODEC_MAGIC, 4) == 0)
+    {
+        string output;
+        if (!decompressStructural(xml, output, 1))
+        {
+            return "";
+        }
+        cout << "Debug: Decompressed output size is " << output.size() << " bytes." << endl;
+        return output;
+    }
 
-    // 3. Reconstruct Dictionary
-    vector<pair<unsigned char, unsigned char>> dict;
-    dict.reserve(dict_size);
+    // 2. Split into dictionary and symbol data
+    BPEStream stream;
+    if (!parseBPEStream(xml, stream))
+    {
+        return "";
+    }
 
-    for (size_t i = 0; i < dict_size; ++i)
+    size_t dict_size = 0;
+    for (const auto &symbol : stream.symbols)
     {
-        unsigned char first, second;
-        ss.read(reinterpret_cast<char *>(&first), sizeof(first));
-        ss.read(reinterpret_cast<char *>(&second), sizeof(second));
-        dict.push_back({first, second});
+        if (stream.wide || !symbol.literal)
+            dict_size++;
     }
+    cout << "Debug: " << (stream.wide ? "Wide symbol table" : "Dictionary") << " size is " << dict_size << " entries." << endl;
+    cout << "Debug: Processing " << stream.dataSize << " bytes of compressed data." << endl;
 
-    // 4. Read Compressed Byte Data
-    //  read directly from the current position to the end
-    streampos data_start = ss.tellg();
+    // 3. Expand every symbol once, then copy expansions instead of recursing per byte
+    BPEExpansionTable table;
+    string output;
+    if (!buildExpansionTable(stream, table) || !expandBPEStream(stream, table, output))
+    {
+        return "";
+    }
 
-    // Read the rest of the stream into a vector directly
-    string remaining_str = xml.substr(data_start);
-    vector<unsigned char> data(remaining_str.begin(), remaining_str.end());
+    cout << "Debug: Decompressed output size is " << output.size() << " bytes." << endl;
+    return output;
+}
 
-    cout << "Debug: Processing " << data.size() << " bytes of compressed data." << endl;
+// Users with the highest count, best first; equal counts keep document order.
+// With k == 0 every user tied for the highest count is returned.
+template <typename Scan>
+static vector<UserSummary> rankUsers(Scan scan, uint32_t UserSummary::*count, size_t k)
+{
+    vector<UserSummary> ranked;
 
-    // 5. Recursive Expansion Logic
-    string output;
+    if (k == 0)
+    {
+        scan([&](const UserSummary &user)
+        {
+            if (!ranked.empty() && user.*count < ranked[0].*count)
+                return;
+            if (!ranked.empty() && user.*count > ranked[0].*count)
+                ranked.clear();
+            ranked.push_back(user);
+        });
+        return ranked;
+    }
 
-    // Recursive lambda
-    function<void(unsigned char)> expand = [&](unsigned char b)
+    // Bounded heap of the best k so far, worst on top: O(n log k), k entries of memory
+    typedef pair<UserSummary, size_t> Entry;  // user, document position
+    auto better = [&](const Entry &a, const Entry &b)
     {
-        int index = (int)b - 128;
+        if (a.first.*count != b.first.*count)
+            return a.first.*count > b.first.*count;
+        return a.second < b.second;
+    };
+    priority_queue<Entry, vector<Entry>, decltype(better)> heap(better);
 
-        if (index >= 0 && index < (int)dict.size())
-        {
-            expand(dict[index].first);
-            expand(dict[index].second);
-        }
-        else
+    size_t position = 0;
+    scan([&](const UserSummary &user)
+    {
+        Entry entry(user, position++);
+        if (heap.size() < k)
+            heap.push(entry);
+        else if (better(entry, heap.top()))
         {
-            output += (char)b;
+            heap.pop();
+            heap.push(entry);
         }
-    };
+    });
 
-    // 6. Generate Decompressed String
-    for (unsigned char b : data)
-    {
-        expand(b);
-    }
+    ranked.resize(heap.size());
+    for (size_t i = heap.size(); i-- > 0; heap.pop())
+        ranked[i] = heap.top().first;
+    return ranked;
+}
 
-    cout << "Debug: Decompressed output size is " << output.size() << " bytes." << endl;
-    return output;
+// Visits the <user> elements of the document, or the records of an index
+static auto documentUsers(const string &xml)
+{
+    return [&xml](const function<void(const UserSummary &)> &visit) { scanUserRecords(xml, visit); };
 }
 
-string most_active(const string &xml)
-{  
-    struct User {
-        string id;
-        string name;
-        int postCount = 0;  // Changed from followCount to postCount
+static auto indexUsers(const SocialIndex &index)
+{
+    return [&index](const function<void(const UserSummary &)> &visit)
+    {
+        index.forEachRecord([&](const SocialRecord &record)
+        {
+            UserSummary user;
+            user.id = index.recordId(record);
+            user.name = index.recordName(record);
+            user.postCount = record.postEnd - record.postBegin;
+            user.followerCount = record.followerCount;
+            visit(user);
+        });
     };
+}
 
-    vector<User> users;
-
-    // -------- 1) Read users (id + name) --------
-    int i = 0;
-    while (i < xml.length()) {
-
-        if (xml.substr(i, 6) == "<user>") {
-            i += 6;
-            User u;
-
-            while (xml.substr(i, 7) != "</user>") {
+static string formatMostActive(const vector<UserSummary> &users, size_t topK)
+{
+    // Default: every user with the most posts on one line; --top K: one line per user
+    string result;
+    for (const auto &u : users) {
+        if (topK == 0 && u.postCount == 0)
+            break;
+        if (!result.empty()) result += topK == 0 ? " | " : "\n";
+        result += "ID: " + string(u.id) + ", Name: " + string(u.name) + " (Posts: " + to_string(u.postCount) + ")";
+    }
 
-                if (xml.substr(i, 4) == "<id>" && u.id.empty()) {
-                    i += 4;
-                    while (xml.substr(i, 5) != "</id>")
-                        u.id += xml[i++];
-                    i += 5;
-                }
-                else if (xml.substr(i, 6) == "<name>") {
-                    i += 6;
-                    while (xml.substr(i, 7) != "</name>")
-                        u.name += xml[i++];
-                    i += 7;
-                }
-                else if (xml.substr(i, 6) == "<post>") {
-                    // Count posts
-                    u.postCount++;
-                    i += 6;
-                }
-                else {
-                    i++;
-                }
-            }
+    return result;
+}
 
-            users.push_back(u);
-            i += 7; // </user>
-        }
-        else {
-            i++;
-        }
-    }
+string most_active(const string &xml, size_t topK)
+{
+    return formatMostActive(rankUsers(documentUsers(xml), &UserSummary::postCount, topK), topK);
+}
 
-    // -------- 2) Find max posts --------
-    int maxPosts = -1;
-    for (auto &u : users)
-        if (u.postCount > maxPosts)
-            maxPosts = u.postCount;
+string most_active(const SocialIndex &index, size_t topK)
+{
+    return formatMostActive(rankUsers(indexUsers(index), &UserSummary::postCount, topK), topK);
+}
 
-    // -------- 3) Build result string --------
+static string formatMostInfluencer(const vector<UserSummary> &users, size_t topK)
+{
     string result;
-    for (auto &u : users) {
-        if (u.postCount == maxPosts && maxPosts > 0) {
-            if (!result.empty()) result += " | ";
-            result += "ID: " + u.id + ", Name: " + u.name + " (Posts: " + to_string(u.postCount) + ")";
-        }
+    for (const auto &u : users) {
+        if (!result.empty()) result += topK == 0 ? " | " : "\n";  // separator between users
+        result += "ID: " + string(u.id) + ", Name: " + string(u.name);
+        if (topK != 0)
+            result += " (Followers: " + to_string(u.followerCount) + ")";
     }
 
     return result;
 }
 
-string most_influencer(const string &xml)
-{    
-    struct User {
-        string id;
-        string name;
-    };
-    
-    vector<User> topUsers;
-    int maxFollowers = -1;
+string most_influencer(const string &xml, size_t topK)
+{
+    return formatMostInfluencer(rankUsers(documentUsers(xml), &UserSummary::followerCount, topK), topK);
+}
 
-    int i = 0;
-    while (i < xml.length()) {
-        if (xml.substr(i, 6) == "<user>") {
-            i += 6;
-
-            string id = "";
-            string name = "";
-            int followerCount = 0;
-            bool idRead = false;
-            bool nameRead = false;
-
-            while (!(xml.substr(i, 7) == "</user>")) {
-                if (!idRead && xml.substr(i, 4) == "<id>") {
-                    i += 4;
-                    while (!(xml.substr(i, 5) == "</id>")) {
-                        id += xml[i++];
-                    }
-                    i += 5;
-                    idRead = true;
-                } else if (!nameRead && xml.substr(i, 6) == "<name>") {
-                    i += 6;
-                    while (!(xml.substr(i, 7) == "</name>")) {
-                        name += xml[i++];
-                    }
-                    i += 7;
-                    nameRead = true;
-                } else if (xml.substr(i, 10) == "<follower>") {
-                    followerCount++;
-                    i += 10;
-                } else {
-                    i++;
-                }
-            }
+string most_influencer(const SocialIndex &index, size_t topK)
+{
+    return formatMostInfluencer(rankUsers(indexUsers(index), &UserSummary::followerCount, topK), topK);
+}
 
-            if (followerCount > maxFollowers) {
-                topUsers.clear();
-                topUsers.push_back({id, name});
-                maxFollowers = followerCount;
-            } else if (followerCount == maxFollowers) {
-                topUsers.push_back({id, name});
-            }
+// Result of the document analytics when build() fails (the reason is on cerr)
+static const char *const INDEX_BUILD_FAILED = "Error: The document's follows do not fit the index.";
 
-            i += 7; // skip </user>
-        } else {
-            i++;
-        }
-    }
+// Ranks over the lists of graph; names come from index
+template <typename Graph>
+static string pagerankOf(const Graph &graph, const SocialIndex &index, const PageRankOptions &options, size_t topK,
+                         string *summary)
+{
+    int iterations;
+    vector<double> rank = computePageRank(graph, options, iterations);
+    if (summary)
+        *summary = "PageRank: " + to_string(index.userCount()) + " users, " + to_string(iterations) + " iterations.";
+
+    // Name of every user that has a record
+    vector<string_view> names(index.userCount());
+    index.forEachRecord([&](const SocialRecord &record) {
+        if (record.user != SOCIAL_NO_USER && names[record.user].empty())
+            names[record.user] = index.recordName(record);
+    });
+
+    // Highest rank first, ties by lower id; only the first topK are ordered
+    vector<uint32_t> order(index.userCount());
+    for (uint32_t u = 0; u < order.size(); ++u)
+        order[u] = u;
+    size_t shown = topK == 0 ? order.size() : min(topK, order.size());
+    partial_sort(order.begin(), order.begin() + shown, order.end(), [&](uint32_t a, uint32_t b) {
+        if (rank[a] != rank[b])
+            return rank[a] > rank[b];
+        return index.externalId(a) < index.externalId(b);
+    });
 
-    // Convert vector of users to single string
-    string result;
-    for (size_t j = 0; j < topUsers.size(); j++) {
-        result += "ID: " + topUsers[j].id + ", Name: " + topUsers[j].name;
-        if (j != topUsers.size() - 1)
-            result += " | ";  // separator between users
+    stringstream out;
+    for (size_t i = 0; i < shown; ++i) {
+        uint32_t u = order[i];
+        out << "ID: " << index.externalId(u) << ", Name: " << names[u] << " (PageRank: " << rank[u] << ")\n";
     }
+    return out.str();
+}
 
-    return result;
+string pagerank(const SocialIndex &index, const PageRankOptions &options, size_t topK, string *summary)
+{
+    return pagerankOf(index, index, options, topK, summary);
 }
 
-string mutual(const string &xml, const vector<int> &ids)
+string pagerank(const CompactGraph &graph, const PageRankOptions &options, size_t topK, string *summary)
 {
-    // --------- HANDLE EDGE CASES ---------
-    if (ids.empty()) {
-        return "Error: No user IDs provided.";
-    }
+    return pagerankOf(graph, graph.index(), options, topK, summary);
+}
 
-    map<int, vector<int>> followers;
+string pagerank(const string &xml, const PageRankOptions &options, size_t topK, string *summary)
+{
+    SocialIndex index;
+    if (!index.build(xml))
+        return INDEX_BUILD_FAILED;
+    return pagerank(index, options, topK, summary);
+}
 
-    // --------- PARSE XML ---------
-    size_t pos = 0;
-    while ((pos = xml.find("<user>", pos)) != string::npos) {
+string components(const SocialIndex &index, int threads)
+{
+    vector<uint32_t> component = weakComponents(index, threads);
+    return describeClusters(index, component, "Component");
+}
 
-        // Find the end of this user block first to ensure we advance properly
-        size_t userEnd = xml.find("</user>", pos);
-        if (userEnd == string::npos) {
-            break;  // No closing tag, exit to avoid infinite loop
-        }
+string components(const string &xml, int threads)
+{
+    SocialIndex index;
+    if (!index.build(xml))
+        return INDEX_BUILD_FAILED;
+    return components(index, threads);
+}
 
-        size_t idStart = xml.find("<id>", pos);
-        size_t idEnd   = xml.find("</id>", pos);
-        
-        // Validate id tags exist and are within this user block
-        if (idStart == string::npos || idEnd == string::npos || idStart > userEnd) {
-            pos = userEnd + 7;  // Move past </user>
-            continue;
-        }
-        
-        idStart += 4;  // Move past <id>
-        int userId = stoi(xml.substr(idStart, idEnd - idStart));
+string communities(const SocialIndex &index, int maxIterations, int threads, string *summary)
+{
+    int iterations;
+    vector<uint32_t> community = labelPropagation(index, maxIterations, threads, iterations);
+    if (summary)
+        *summary = "Label propagation: " + to_string(index.userCount()) + " users, " + to_string(iterations) + " iterations.";
+    return describeClusters(index, community, "Community");
+}
 
-        size_t followersStart = xml.find("<followers>", pos);
-        size_t followersEnd   = xml.find("</followers>", pos);
+string communities(const string &xml, int maxIterations, int threads, string *summary)
+{
+    SocialIndex index;
+    if (!index.build(xml))
+        return INDEX_BUILD_FAILED;
+    return communities(index, maxIterations, threads, summary);
+}
 
-        // Only process followers if both tags exist and are within this user block
-        if (followersStart != string::npos && followersEnd != string::npos && 
-            followersStart < userEnd && followersEnd < userEnd) {
-            
-            size_t fpos = followersStart;
-            while ((fpos = xml.find("<follower>", fpos)) != string::npos &&
-                   fpos < followersEnd) {
+string triangles(const SocialIndex &index, int threads)
+{
+    TriangleCounts counts = countTriangles(index, threads);
 
-                size_t fStart = fpos + 10;  // Move past <follower>
-                size_t fEnd = xml.find("</follower>", fStart);
-                
-                if (fEnd == string::npos || fEnd > followersEnd) {
-                    break;
-                }
-                
-                // Get the content between <follower> and </follower>
-                string followerContent = xml.substr(fStart, fEnd - fStart);
-                
-                // Check if there's a nested <id> tag or direct content
-                size_t nestedIdStart = followerContent.find("<id>");
-                if (nestedIdStart != string::npos) {
-                    // Nested id format: <follower><id>X</id></follower>
-                    size_t nestedIdEnd = followerContent.find("</id>");
-                    if (nestedIdEnd != string::npos) {
-                        string idStr = followerContent.substr(nestedIdStart + 4, nestedIdEnd - nestedIdStart - 4);
-                        int followerId = stoi(idStr);
-                        followers[userId].push_back(followerId);
-                    }
-                } else {
-                    // Direct content format: <follower>X</follower>
-                    // Trim whitespace
-                    size_t start = followerContent.find_first_not_of(" \t\n\r");
-                    size_t end = followerContent.find_last_not_of(" \t\n\r");
-                    if (start != string::npos && end != string::npos) {
-                        string idStr = followerContent.substr(start, end - start + 1);
-                        int followerId = stoi(idStr);
-                        followers[userId].push_back(followerId);
-                    }
-                }
+    double average = 0;
+    for (uint32_t u = 0; u < index.userCount(); ++u)
+        average += localClustering(counts, u);
+    if (index.userCount() > 0)
+        average /= index.userCount();
 
-                fpos = fEnd + 11;  // Move past </follower>
-            }
-        }
+    stringstream out;
+    out << "Triangles: " << counts.total << "\n";
+    out << "Global clustering coefficient: " << globalClustering(counts) << "\n";
+    out << "Average clustering coefficient: " << average << "\n";
+    for (uint32_t u = 0; u < index.userCount(); ++u) {
+        out << "User ID: " << index.externalId(u) << ", Triangles: " << counts.perUser[u]
+            << ", Clustering: " << localClustering(counts, u) << "\n";
+    }
+    return out.str();
+}
+
+string triangles(const string &xml, int threads)
+{
+    SocialIndex index;
+    if (!index.build(xml))
+        return INDEX_BUILD_FAILED;
+    return triangles(index, threads);
+}
 
-        pos = userEnd + 7;  // Move past </user> to next user
+template <typename Graph>
+static string mutualOf(const Graph &index, const vector<int> &ids)
+{
+    // --------- HANDLE EDGE CASES ---------
+    if (ids.empty()) {
+        return "Error: No user IDs provided.";
     }
 
     // --------- HANDLE SINGLE USER CASE ---------
     if (ids.size() == 1) {
         int singleId = ids[0];
-        if (followers.find(singleId) == followers.end() || followers[singleId].empty()) {
+        uint32_t user = index.find(singleId);
+        if (user == SOCIAL_NO_USER || index.followers(user).empty()) {
             return "User " + to_string(singleId) + " has no followers.";
         }
-        
+
         stringstream out;
         out << "Followers of user " << singleId << ":\n";
-        for (int u : followers[singleId])
-            out << "User ID: " << u << "\n";
+        for (uint32_t u : index.followers(user))
+            out << "User ID: " << index.externalId(u) << "\n";
         return out.str();
     }
 
     // --------- FIND MUTUAL FOLLOWERS ---------
-    vector<int> result = followers[ids[0]];
-
-    for (size_t i = 1; i < ids.size(); i++) {
-        vector<int> temp;
-        for (int u : result) {
-            if (find(followers[ids[i]].begin(),
-                     followers[ids[i]].end(),
-                     u) != followers[ids[i]].end()) {
-                temp.push_back(u);
-            }
-        }
-        result = temp;
+    vector<decltype(index.sortedFollowers(0))> lists;
+    for (int id : ids) {
+        uint32_t user = index.find(id);
+        if (user == SOCIAL_NO_USER)
+            return "No mutual followers found.";
+        lists.push_back(index.sortedFollowers(user));
+    }
+
+    vector<uint32_t> common;
+    intersectSorted(lists, index.userCount(), common);
+
+    // Listed in the order they follow the first user
+    vector<uint32_t> result;
+    for (uint32_t u : index.followers(index.find(ids[0]))) {
+        if (binary_search(common.begin(), common.end(), u))
+            result.push_back(u);
     }
 
     // --------- FORMAT OUTPUT ---------
@@ -1212,81 +1304,237 @@ string mutual(const string &xml, const vector<int> &ids)
             out << ", and ";
     }
     out << ":\n";
-    for (int u : result)
-        out << "User ID: " << u << "\n";
+    for (uint32_t u : result)
+        out << "User ID: " << index.externalId(u) << "\n";
 
     return out.str();
 }
 
-string suggest(const string &xml, int userId)
+string mutual(const SocialIndex &index, const vector<int> &ids)
 {
-    Graph followersGraph = buildGraphFromXML(xml);
-    string result;
+    return mutualOf(index, ids);
+}
+
+string mutual(const CompactGraph &graph, const vector<int> &ids)
+{
+    return mutualOf(graph, ids);
+}
 
-    Graph followingGraph;
+string mutual(const string &xml, const vector<int> &ids)
+{
+    SocialIndex index;
+    if (!index.build(xml))
+        return INDEX_BUILD_FAILED;
+    return mutual(index, ids);
+}
 
-    for (const auto &entry : followersGraph)
+// Reads the -k / --score options; false after reporting an unknown weighting
+static bool suggestOptions(size_t limit, const string &weighting, SuggestOptions &options)
+{
+    options.limit = limit;
+    if (!parseSuggestWeighting(weighting, options.weighting))
     {
-        int followedUser = entry.first;
-        const vector<int> &followers = entry.second;
+        cerr << "Error: Unknown suggestion score '" << weighting << "' (expected common, adamic-adar, jaccard or minhash)" << endl;
+        return false;
+    }
+    return true;
+}
 
-        for (int follower : followers)
-        {
-            followingGraph[follower].push_back(followedUser);
-        }
+string shortest_path(const SocialIndex &index, const vector<int> &ids, const string &direction, string *summary)
+{
+    if (ids.size() != 2) {
+        return "Error: path needs exactly two user IDs.";
     }
 
-    if (followingGraph.find(userId) == followingGraph.end())
-    {
-        return result;
+    PathDirection pathDirection;
+    if (!parsePathDirection(direction, pathDirection)) {
+        return "Error: Unknown direction '" + direction + "' (use following, followers or any).";
     }
 
-    const vector<int> &myFollowing = followingGraph[userId];
+    uint32_t source = index.find(ids[0]);
+    uint32_t target = index.find(ids[1]);
+    for (int i = 0; i < 2; ++i) {
+        if ((i == 0 ? source : target) == SOCIAL_NO_USER)
+            return "Error: User " + to_string(ids[i]) + " not found.";
+    }
 
-    unordered_map<int, bool> alreadyFollowing;
-    for (int id : myFollowing)
+    vector<uint32_t> chain;
+    size_t visited;
+    bool found = shortestPath(index, source, target, pathDirection, chain, visited);
+    if (summary)
+        *summary = "Path search: reached " + to_string(visited) + " of " + to_string(index.userCount()) + " users.";
+
+    if (!found) {
+        return "User " + to_string(ids[1]) + " cannot be reached from user " + to_string(ids[0]) +
+               " (direction: " + direction + ").";
+    }
+
+    // "a -> b": a follows b
+    const char *arrow = pathDirection == PATH_FOLLOWING ? " -> " : pathDirection == PATH_FOLLOWERS ? " <- " : " - ";
+    stringstream out;
+    out << "Shortest chain from " << ids[0] << " to " << ids[1] << ": " << chain.size() - 1 << " steps\n";
+    for (size_t i = 0; i < chain.size(); ++i) {
+        if (i > 0)
+            out << arrow;
+        out << index.externalId(chain[i]);
+    }
+    out << "\n";
+    return out.str();
+}
+
+string shortest_path(const string &xml, const vector<int> &ids, const string &direction, string *summary)
+{
+    SocialIndex index;
+    if (!index.build(xml))
+        return INDEX_BUILD_FAILED;
+    return shortest_path(index, ids, direction, summary);
+}
+
+// sketch holds the MinHash signatures of index, or is null to build them here
+template <typename Graph>
+static string suggestOf(const Graph &index, int userId, size_t limit, const string &weighting,
+                        const AudienceSketch *sketch)
+{
+    SuggestOptions options;
+    if (!suggestOptions(limit, weighting, options))
     {
-        alreadyFollowing[id] = true;
+        return "";
     }
-    alreadyFollowing[userId] = true; 
 
-    map<int, int> candidateScores;
+    string result;
 
-    for (int friendId : myFollowing)
+    uint32_t user = index.find(userId);
+    if (user == SOCIAL_NO_USER)
     {
-        if (followingGraph.find(friendId) != followingGraph.end())
+        return result;
+    }
+
+    SuggestScratch scratch;
+    scratch.resize(index.userCount());
+    vector<uint32_t> candidates;
+    if (options.weighting == SUGGEST_MINHASH)
+    {
+        AudienceSketch built;
+        if (!sketch)
         {
-            const vector<int> &friendsFollowing = followingGraph[friendId];
-            for (int candidateId : friendsFollowing)
-            {
-                if (alreadyFollowing.find(candidateId) == alreadyFollowing.end())
-                {
-                    candidateScores[candidateId]++;
-                }
-            }
+            built.build(index);
+            sketch = &built;
         }
+        suggestSimilarUsers(*sketch, index, user, options.limit, scratch, candidates);
+    }
+    else
+    {
+        suggestUsers(index, user, options, scratch, candidates);
     }
 
-    vector<pair<int, int>> sortedCandidates;
-    for (const auto &entry : candidateScores)
+    for (uint32_t candidate : candidates)
     {
-        sortedCandidates.push_back(entry);
+        result += to_string(index.externalId(candidate)) + "\n";
     }
 
-    sort(sortedCandidates.begin(), sortedCandidates.end(),
-         [](const pair<int, int> &a, const pair<int, int> &b)
-         {
-             return a.second > b.second; // Higher score first
-         });
+    return result;
+}
+
+string suggest(const SocialIndex &index, int userId, size_t limit, const string &weighting)
+{
+    return suggestOf(index, userId, limit, weighting, nullptr);
+}
+
+string suggest(const SocialIndex &index, int userId, size_t limit, const string &weighting, const AudienceSketch &sketch)
+{
+    return suggestOf(index, userId, limit, weighting, &sketch);
+}
+
+string suggest(const CompactGraph &graph, int userId, size_t limit, const string &weighting)
+{
+    return suggestOf(graph, userId, limit, weighting, nullptr);
+}
+
+string suggest(const string &xml, int userId, size_t limit, const string &weighting)
+{
+    SocialIndex index;
+    if (!index.build(xml))
+        return INDEX_BUILD_FAILED;
+    return suggest(index, userId, limit, weighting);
+}
+
+template <typename Graph>
+static string suggestBatchOf(const Graph &index, const vector<int> &ids, int threads, size_t limit, const string &weighting)
+{
+    SuggestOptions options;
+    if (!suggestOptions(limit, weighting, options))
+    {
+        return "";
+    }
 
-    for (const auto &candidate : sortedCandidates)
+    // Every user in dense order unless a list was given
+    vector<uint32_t> users;
+    if (ids.empty())
     {
-        result += to_string(candidate.first) + "\n";
+        for (uint32_t u = 0; u < index.userCount(); ++u)
+            users.push_back(u);
+    }
+    else
+    {
+        for (int id : ids)
+            users.push_back(index.find(id));
     }
 
+    // The signatures are built once and shared by every worker
+    AudienceSketch sketch;
+    if (options.weighting == SUGGEST_MINHASH)
+        sketch.build(index, threads);
+
+    // Contiguous ranges per worker, each with its own scratch arrays and output
+    int workers = resolveThreadCount(threads);
+    vector<string> parts(workers);
+    parallelFor(users.size(), workers, [&](size_t begin, size_t end, int worker)
+    {
+        SuggestScratch scratch;
+        scratch.resize(index.userCount());
+        vector<uint32_t> candidates;
+        string &out = parts[worker];
+
+        for (size_t i = begin; i < end; ++i)
+        {
+            out += to_string(ids.empty() ? index.externalId(users[i]) : ids[i]) + ":";
+            if (users[i] != SOCIAL_NO_USER)
+            {
+                if (options.weighting == SUGGEST_MINHASH)
+                    suggestSimilarUsers(sketch, index, users[i], options.limit, scratch, candidates);
+                else
+                    suggestUsers(index, users[i], options, scratch, candidates);
+                for (uint32_t candidate : candidates)
+                    out += " " + to_string(index.externalId(candidate));
+            }
+            out += "\n";
+        }
+    });
+
+    string result;
+    for (const string &part : parts)
+        result += part;
     return result;
 }
 
+string suggestBatch(const SocialIndex &index, const vector<int> &ids, int threads, size_t limit, const string &weighting)
+{
+    return suggestBatchOf(index, ids, threads, limit, weighting);
+}
+
+string suggestBatch(const CompactGraph &graph, const vector<int> &ids, int threads, size_t limit, const string &weighting)
+{
+    return suggestBatchOf(graph, ids, threads, limit, weighting);
+}
+
+string suggestBatch(const string &xml, const vector<int> &ids, int threads, size_t limit, const string &weighting)
+{
+    SocialIndex index;
+    if (!index.build(xml))
+        return INDEX_BUILD_FAILED;
+    return suggestBatch(index, ids, threads, limit, weighting);
+}
+
 vector<string> searchPostsByWord(const string& xml, const string& word) {
     vector<string> results;
 
@@ -1380,10 +1628,53 @@ vector<int> strIDs2int(const string &ids) {
 
     // Use getline to split the string by the comma delimiter
     while (getline(ss, segment, ',')) {
-        // Convert the string segment to an integer and push it to the vector
-        Ids.push_back(stoi(segment));
+        // The whole segment must be an integer; the error names the one that is not
+        size_t used = 0;
+        int id = 0;
+        try {
+            id = stoi(segment, &used);
+        } catch (const logic_error &) {
+            used = 0;
+        }
+        if (used == 0 || used != segment.size())
+            throw invalid_argument("'" + segment + "' is not a user id");
+        Ids.push_back(id);
     }
 
     return Ids;
 }
 
+vector<string> searchPostsByWord(const SocialIndex &index, const string &word)
+{
+    vector<string> results;
+    index.forEachRecord([&](const SocialRecord &record) {
+        for (const auto &post : index.recordPosts(record)) {
+            // Posts without a <body> are skipped, as in the document search
+            if (post.bodyLength == 0)
+                continue;
+            string_view body = index.postBody(post);
+            if (body.find(word) != string_view::npos)
+                results.emplace_back(body);
+        }
+    });
+    return results;
+}
+
+vector<string> searchPostsByTopic(const SocialIndex &index, const string &topic)
+{
+    vector<string> results;
+    index.forEachRecord([&](const SocialRecord &record) {
+        for (const auto &post : index.recordPosts(record)) {
+            if (post.bodyLength == 0)
+                continue;
+            for (uint32_t t : index.postTopics(post)) {
+                if (index.topicName(t) == topic) {
+                    results.emplace_back(index.postBody(post));
+                    break;
+                }
+            }
+        }
+    });
+    return results;
+}
+
@@ -55,16 +55,66 @@ string extract_tag_name(const string& tag);
 string format(const string &xml);
 string json(const string &xml);
 string mini(const string &xml);
-string compress(const string &xml);
+// Empty after reporting an unknown mode or level (or empty input) on cerr
+string compress(const string &xml, const string &mode = "bpe", int threads = 1, int level = 1);
 string decompress(const string &xml);
 string draw(const string &xml);
 string fixation(const string &xml);
-string most_active(const string &xml);
-string most_influencer(const string &xml);
+// topK = 0 lists every user tied for first place; otherwise the best topK users, one per line
+string most_active(const string &xml, size_t topK = 0);
+string most_influencer(const string &xml, size_t topK = 0);
+// Users ranked by PageRank over the follower graph, one per line (topK = 0: all users).
+// pagerank, communities and shortest_path leave a one-line run summary in *summary
+// when it is given; the library itself never prints it.
+struct PageRankOptions;
+string pagerank(const string &xml, const PageRankOptions &options, size_t topK = 0, string *summary = nullptr);
+// Weakly connected components / label-propagation communities, one line per user
+// followed by the cluster size histogram
+string components(const string &xml, int threads = 1);
+string communities(const string &xml, int maxIterations = 20, int threads = 1, string *summary = nullptr);
+// Triangle count and global clustering coefficient, then one line per user with
+// its triangles and local clustering coefficient
+string triangles(const string &xml, int threads = 1);
 string mutual(const string &xml, const vector<int> &ids);
-string suggest(const string &xml, int userId);
+// Shortest follow chain between ids[0] and ids[1]; direction is following, followers or any
+string shortest_path(const string &xml, const vector<int> &ids, const string &direction = "following",
+                     string *summary = nullptr);
+// limit keeps the best K suggestions (0 = all); weighting is common, adamic-adar or jaccard
+string suggest(const string &xml, int userId, size_t limit = 0, const string &weighting = "common");
+// One line per user, "id: suggestion suggestion ..."; all users when ids is empty
+string suggestBatch(const string &xml, const vector<int> &ids, int threads = 1, size_t limit = 0,
+                    const string &weighting = "common");
 vector<string> searchPostsByWord(const string& xml, const string& word);
 vector<string> searchPostsByTopic(const string& xml, const string& topic);
+
+// --- The same analytics over a built or mapped index (social_index.h) ---
+class SocialIndex;
+string most_active(const SocialIndex &index, size_t topK = 0);
+string most_influencer(const SocialIndex &index, size_t topK = 0);
+string pagerank(const SocialIndex &index, const PageRankOptions &options, size_t topK = 0, string *summary = nullptr);
+string components(const SocialIndex &index, int threads = 1);
+string communities(const SocialIndex &index, int maxIterations = 20, int threads = 1, string *summary = nullptr);
+string triangles(const SocialIndex &index, int threads = 1);
+string mutual(const SocialIndex &index, const vector<int> &ids);
+string shortest_path(const SocialIndex &index, const vector<int> &ids, const string &direction = "following",
+                     string *summary = nullptr);
+string suggest(const SocialIndex &index, int userId, size_t limit = 0, const string &weighting = "common");
+// Reuses sketch, the MinHash signatures of index (minhash.h), for minhash scores
+class AudienceSketch;
+string suggest(const SocialIndex &index, int userId, size_t limit, const string &weighting, const AudienceSketch &sketch);
+string suggestBatch(const SocialIndex &index, const vector<int> &ids, int threads = 1, size_t limit = 0,
+                    const string &weighting = "common");
+vector<string> searchPostsByWord(const SocialIndex &index, const string &word);
+vector<string> searchPostsByTopic(const SocialIndex &index, const string &topic);
+
+// --- Over the varint-coded lists of a CompactGraph (compact_graph.h) ---
+class CompactGraph;
+string pagerank(const CompactGraph &graph, const PageRankOptions &options, size_t topK = 0, string *summary = nullptr);
+string mutual(const CompactGraph &graph, const vector<int> &ids);
+string suggest(const CompactGraph &graph, int userId, size_t limit = 0, const string &weighting = "common");
+string suggestBatch(const CompactGraph &graph, const vector<int> &ids, int threads = 1, size_t limit = 0,
+                    const string &weighting = "common");
+// Comma-separated ids; throws invalid_argument naming the first token that is not an id
 vector<int> strIDs2int(const string &ids);
 
 #endif
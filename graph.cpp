@@ -2,65 +2,21 @@
 
 using namespace std;
 
-/*--------------------------------------------------
-  Parse XML content and build graph
---------------------------------------------------*/
-Graph buildGraphFromXML(const string& xmlContent)
-{
-    Graph graph;
-    XMLDocument doc;
-
-    if (doc.Parse(xmlContent.c_str()) != XML_SUCCESS)
-    {
-        cerr << "Error: Invalid XML\n";
-        return graph;
-    }
-
-    XMLElement* users = doc.FirstChildElement("users");
-    if (!users) return graph;
-
-    for (XMLElement* user = users->FirstChildElement("user");
-         user;
-         user = user->NextSiblingElement("user"))
-    {
-        XMLElement* idElem = user->FirstChildElement("id");
-        if (!idElem || !idElem->GetText()) continue;
-
-        int userId = stoi(idElem->GetText());
-        graph[userId]; // ensure node exists
-
-        XMLElement* followers = user->FirstChildElement("followers");
-        if (!followers) continue;
-
-        for (XMLElement* follower = followers->FirstChildElement("follower");
-             follower;
-             follower = follower->NextSiblingElement("follower"))
-        {
-            XMLElement* fid = follower->FirstChildElement("id");
-            if (!fid || !fid->GetText()) continue;
-
-            int followerId = stoi(fid->GetText());
-            graph[userId].push_back(followerId);
-        }
-    }
-
-    return graph;
-}
-
 /*--------------------------------------------------
   Export graph to DOT file
 --------------------------------------------------*/
-void exportToDot(const Graph& graph, const string& dotFile)
+void exportToDot(const SocialIndex& index, const string& dotFile)
 {
     ofstream out(dotFile);
     out << "digraph SocialNetwork {\n";
     out << "  node [shape=circle, style=filled, fillcolor=lightblue];\n";
 
-    for (const auto& [user, followers] : graph)
+    // user -> follower, in document order
+    for (uint32_t user = 0; user < index.userCount(); ++user)
     {
-        for (int f : followers)
+        for (uint32_t f : index.followers(user))
         {
-            out << "  " << user << " -> " << f << ";\n";
+            out << "  " << index.externalId(user) << " -> " << index.externalId(f) << ";\n";
         }
     }
 
@@ -85,10 +41,16 @@ void renderGraph(const string& dotFile, const string& outputImage)
   Public API (matches assignment)
 --------------------------------------------------*/
 void drawXMLGraph(const string& xmlContent, const string& outputImage)
+{
+    SocialIndex index;
+    if (index.build(xmlContent))
+        drawIndexGraph(index, outputImage);
+}
+
+void drawIndexGraph(const SocialIndex& index, const string& outputImage)
 {
     const string dotFile = "temp_graph.dot";
 
-    Graph graph = buildGraphFromXML(xmlContent);
-    exportToDot(graph, dotFile);
+    exportToDot(index, dotFile);
     renderGraph(dotFile, outputImage);
 }
@@ -4,22 +4,19 @@
 #include <iostream>
 #include <fstream>
 #include <string>
-#include <unordered_map>
 #include <vector>
 #include <cstdlib>
 
-#include "external/tinyxml2/tinyxml2.h"
+#include "social_index.h"
 
 using namespace std;
-using namespace tinyxml2;
 
-// Graph: user -> followers
-using Graph = unordered_map<int, vector<int>>;
-
-Graph buildGraphFromXML(const string& xmlContent);
-void exportToDot(const Graph& graph, const string& dotFile);
+// The follow graph is the CSR of a SocialIndex: users are dense ids 0..N-1 and
+// their followers one flat array; external ids are looked up only when written out.
+void exportToDot(const SocialIndex& index, const string& dotFile);
 void renderGraph(const string& dotFile, const string& outputImage);
 void drawXMLGraph(const string& xmlContent, const string& outputImage);
+void drawIndexGraph(const SocialIndex& index, const string& outputImage);
 
 
-#endif
\ No newline at end of file
+#endif
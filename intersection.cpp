@@ -0,0 +1,127 @@
+#include "intersection.h"
+
+#include <algorithm>
+
+using namespace std;
+
+// ==================== Pairwise Steps ====================
+
+// Branch-free merge: both cursors advance on equal values, the smaller one otherwise
+static size_t mergeIntersect(const uint32_t *a, size_t na, const uint32_t *b, size_t nb, uint32_t *out)
+{
+    size_t i = 0, j = 0, k = 0;
+    while (i < na && j < nb)
+    {
+        uint32_t x = a[i], y = b[j];
+        out[k] = x;
+        k += x == y;
+        i += x <= y;
+        j += y <= x;
+    }
+    return k;
+}
+
+// For each candidate, gallop forward in the long list from where the last one was found
+static size_t gallopIntersect(const uint32_t *a, size_t na, const uint32_t *b, size_t nb, uint32_t *out)
+{
+    size_t k = 0, lo = 0;
+    for (size_t i = 0; i < na && lo < nb; ++i)
+    {
+        uint32_t x = a[i];
+        size_t step = 1, hi = lo;
+        while (hi < nb && b[hi] < x)
+        {
+            lo = hi + 1;
+            hi += step;
+            step <<= 1;
+        }
+        lo = lower_bound(b + lo, b + min(hi + 1, nb), x) - b;
+        if (lo < nb && b[lo] == x)
+            out[k++] = x;
+    }
+    return k;
+}
+
+static size_t bitsetIntersect(const uint32_t *a, size_t na, AdjacencyRange list, vector<uint64_t> &bits,
+                              uint32_t *out)
+{
+    for (uint32_t id : list)
+        bits[id >> 6] |= 1ull << (id & 63);
+
+    size_t k = 0;
+    for (size_t i = 0; i < na; ++i)
+    {
+        out[k] = a[i];
+        k += (bits[a[i] >> 6] >> (a[i] & 63)) & 1;
+    }
+
+    for (uint32_t id : list)
+        bits[id >> 6] = 0;
+    return k;
+}
+
+// ==================== Multiway ====================
+
+void intersectSorted(vector<AdjacencyRange> lists, size_t universe, vector<uint32_t> &result)
+{
+    result.clear();
+    if (lists.empty())
+        return;
+
+    sort(lists.begin(), lists.end(),
+         [](const AdjacencyRange &x, const AdjacencyRange &y) { return x.size() < y.size(); });
+
+    result.assign(lists[0].begin(), lists[0].end());
+    vector<uint64_t> bits;
+
+    for (size_t l = 1; l < lists.size() && !result.empty(); ++l)
+    {
+        const AdjacencyRange &list = lists[l];
+        size_t count;
+
+        // Results are written over the candidates: every step writes at most as many as it has read
+        if (list.size() >= result.size() * INTERSECT_GALLOP_RATIO)
+        {
+            count = gallopIntersect(result.data(), result.size(), list.begin(), list.size(), result.data());
+        }
+        else if (list.size() * INTERSECT_BITSET_DENSITY >= universe)
+        {
+            if (bits.empty())
+                bits.assign(universe / 64 + 1, 0);
+            count = bitsetIntersect(result.data(), result.size(), list, bits, result.data());
+        }
+        else
+        {
+            count = mergeIntersect(result.data(), result.size(), list.begin(), list.size(), result.data());
+        }
+        result.resize(count);
+    }
+}
+
+void intersectSorted(vector<CompactRange> lists, size_t, vector<uint32_t> &result)
+{
+    result.clear();
+    if (lists.empty())
+        return;
+
+    sort(lists.begin(), lists.end(),
+         [](const CompactRange &x, const CompactRange &y) { return x.size() < y.size(); });
+
+    result.assign(lists[0].begin(), lists[0].end());
+
+    for (size_t l = 1; l < lists.size() && !result.empty(); ++l)
+    {
+        // Candidates are kept in place, behind the read cursor
+        size_t count = 0, i = 0;
+        for (uint32_t id : lists[l])
+        {
+            while (i < result.size() && result[i] < id)
+                i++;
+            if (i == result.size())
+                break;
+            if (result[i] == id)
+                result[count++] = result[i++];
+        }
+        result.resize(count);
+    }
+}
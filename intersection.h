@@ -0,0 +1,28 @@
+#ifndef INTERSECTION_H
+#define INTERSECTION_H
+
+#include <vector>
+#include <cstdint>
+
+#include "social_index.h"
+#include "compact_graph.h"
+
+using namespace std;
+
+// Above this size ratio the shorter list is galloped through the longer one
+// (exponential then binary search) instead of merged
+const size_t INTERSECT_GALLOP_RATIO = 32;
+
+// A list holding at least 1 / INTERSECT_BITSET_DENSITY of all users is loaded
+// into a bitset and the candidates are tested against it
+const size_t INTERSECT_BITSET_DENSITY = 16;
+
+// Intersects sorted, repeat-free lists of dense ids below universe.
+// The lists are taken smallest first, so the candidate set only shrinks.
+void intersectSorted(vector<AdjacencyRange> lists, size_t universe, vector<uint32_t> &result);
+
+// The same over varint-coded lists: they are read front to back, so each one is
+// merged with the candidates as it is decoded
+void intersectSorted(vector<CompactRange> lists, size_t universe, vector<uint32_t> &result);
+
+#endif
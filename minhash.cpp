@@ -0,0 +1,199 @@
+#include "minhash.h"
+#include "compact_graph.h"
+#include "parallel.h"
+
+#include <algorithm>
+
+using namespace std;
+
+// ==================== Hashing ====================
+
+// splitmix64 finalizer
+static uint64_t minhashMix(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBull;
+    x ^= x >> 31;
+    return x;
+}
+
+// One odd multiplier per hash function: a follower is mixed once, then hash k is
+// the high half of mixed * multiplier k (multiply-shift), which vectorizes
+struct MinHashSeeds
+{
+    uint64_t multiplier[MINHASH_HASHES];
+
+    MinHashSeeds()
+    {
+        for (size_t k = 0; k < MINHASH_HASHES; ++k)
+            multiplier[k] = minhashMix(k + 1) | 1;
+    }
+};
+
+uint64_t AudienceSketch::bandKey(uint32_t user, size_t band) const
+{
+    const uint32_t *rows = &user_Signatures[user * MINHASH_HASHES + band * MINHASH_ROWS];
+    uint64_t key = band;
+    for (size_t r = 0; r < MINHASH_ROWS; ++r)
+        key = minhashMix(key ^ rows[r]);
+    return key;
+}
+
+bool AudienceSketch::sameBand(uint32_t a, uint32_t b, size_t band) const
+{
+    const uint32_t *x = &user_Signatures[a * MINHASH_HASHES + band * MINHASH_ROWS];
+    const uint32_t *y = &user_Signatures[b * MINHASH_HASHES + band * MINHASH_ROWS];
+    return equal(x, x + MINHASH_ROWS, y);
+}
+
+// ==================== Signatures and Bands ====================
+
+template <typename Graph>
+void AudienceSketch::build(const Graph &graph, int threads)
+{
+    static const MinHashSeeds seeds;
+    user_Count = graph.userCount();
+    user_Signatures.assign(user_Count * MINHASH_HASHES, UINT32_MAX);
+    user_Signed.assign(user_Count, 0);
+
+    parallelFor(user_Count, threads, [&](size_t begin, size_t end, int)
+    {
+        for (size_t u = begin; u < end; ++u)
+        {
+            uint32_t *signature = &user_Signatures[u * MINHASH_HASHES];
+            for (uint32_t follower : graph.sortedFollowers((uint32_t)u))
+            {
+                user_Signed[u] = 1;
+                uint64_t mixed = minhashMix((uint32_t)graph.externalId(follower));
+                for (size_t k = 0; k < MINHASH_HASHES; ++k)
+                    signature[k] = min(signature[k], (uint32_t)((mixed * seeds.multiplier[k]) >> 32));
+            }
+        }
+    });
+
+    signed_Count = count(user_Signed.begin(), user_Signed.end(), 1);
+    band_Members.assign(MINHASH_BANDS * signed_Count, 0);
+    band_Positions.assign(MINHASH_BANDS * user_Count, 0);
+
+    // Each band is sorted on its own; ties go by external id, so the buckets are
+    // the same for any number of threads and any layout of the dense ids
+    parallelFor(MINHASH_BANDS, threads, [&](size_t begin, size_t end, int)
+    {
+        vector<pair<uint64_t, uint32_t>> keyed;
+        for (size_t b = begin; b < end; ++b)
+        {
+            keyed.clear();
+            for (uint32_t u = 0; u < user_Count; ++u)
+            {
+                if (user_Signed[u])
+                    keyed.push_back({bandKey(u, b), u});
+            }
+            sort(keyed.begin(), keyed.end(), [&](const pair<uint64_t, uint32_t> &a, const pair<uint64_t, uint32_t> &b)
+            {
+                if (a.first != b.first)
+                    return a.first < b.first;
+                return graph.externalId(a.second) < graph.externalId(b.second);
+            });
+
+            for (size_t i = 0; i < keyed.size(); ++i)
+            {
+                band_Members[b * signed_Count + i] = keyed[i].second;
+                band_Positions[b * user_Count + keyed[i].second] = (uint32_t)i;
+            }
+        }
+    });
+}
+
+template void AudienceSketch::build(const SocialIndex &, int);
+template void AudienceSketch::build(const CompactGraph &, int);
+
+void AudienceSketch::candidates(uint32_t user, vector<uint32_t> &result) const
+{
+    result.clear();
+    if (!user_Signed[user])
+        return;
+
+    for (size_t b = 0; b < MINHASH_BANDS; ++b)
+    {
+        const uint32_t *members = &band_Members[b * signed_Count];
+        size_t position = band_Positions[b * user_Count + user];
+
+        // Up to half a window on each side, without leaving the bucket
+        size_t first = position, last = position + 1;
+        while (first > 0 && position - first < MINHASH_BUCKET_WINDOW / 2 && sameBand(members[first - 1], user, b))
+            first--;
+        while (last < signed_Count && last - position <= MINHASH_BUCKET_WINDOW / 2 && sameBand(members[last], user, b))
+            last++;
+
+        for (size_t i = first; i < last; ++i)
+        {
+            if (members[i] != user)
+                result.push_back(members[i]);
+        }
+    }
+}
+
+double AudienceSketch::similarity(uint32_t a, uint32_t b) const
+{
+    const uint32_t *x = &user_Signatures[a * MINHASH_HASHES];
+    const uint32_t *y = &user_Signatures[b * MINHASH_HASHES];
+    size_t equal = 0;
+    for (size_t k = 0; k < MINHASH_HASHES; ++k)
+        equal += x[k] == y[k];
+    return (double)equal / MINHASH_HASHES;
+}
+
+// ==================== Suggestions ====================
+
+template <typename Graph>
+void suggestSimilarUsers(const AudienceSketch &sketch, const Graph &graph, uint32_t user, size_t limit,
+                         SuggestScratch &scratch, vector<uint32_t> &result)
+{
+    sketch.candidates(user, result);
+
+    for (uint32_t id : graph.following(user))
+        scratch.excluded[id] = 1;
+    scratch.excluded[user] = 1;
+
+    // Each candidate once, scored by its estimated similarity
+    size_t kept = 0;
+    for (uint32_t candidate : result)
+    {
+        if (scratch.excluded[candidate] || scratch.count[candidate]++ != 0)
+            continue;
+        scratch.weight[candidate] = sketch.similarity(user, candidate);
+        result[kept++] = candidate;
+    }
+    result.resize(kept);
+
+    const vector<double> &weight = scratch.weight;
+    auto better = [&](uint32_t a, uint32_t b)
+    {
+        if (weight[a] != weight[b])
+            return weight[a] > weight[b];
+        return graph.externalId(a) < graph.externalId(b);
+    };
+
+    size_t shown = limit > 0 ? min(limit, result.size()) : result.size();
+    if (shown < result.size())
+        nth_element(result.begin(), result.begin() + shown, result.end(), better);
+    sort(result.begin(), result.begin() + shown, better);
+
+    // Only the entries set above are cleared, so the next user starts from zero
+    for (uint32_t candidate : result)
+    {
+        scratch.count[candidate] = 0;
+        scratch.weight[candidate] = 0;
+    }
+    result.resize(shown);
+    for (uint32_t id : graph.following(user))
+        scratch.excluded[id] = 0;
+    scratch.excluded[user] = 0;
+}
+
+template void suggestSimilarUsers(const AudienceSketch &, const SocialIndex &, uint32_t, size_t, SuggestScratch &,
+                                  vector<uint32_t> &);
+template void suggestSimilarUsers(const AudienceSketch &, const CompactGraph &, uint32_t, size_t, SuggestScratch &,
+                                  vector<uint32_t> &);
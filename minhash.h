@@ -0,0 +1,59 @@
+#ifndef MINHASH_H
+#define MINHASH_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "social_index.h"
+#include "recommend.h"
+
+using namespace std;
+
+// Signature of a follower set: MINHASH_BANDS bands of MINHASH_ROWS minimum hashes.
+// Two users whose follower sets have Jaccard similarity s share at least one band
+// with probability 1 - (1 - s^ROWS)^BANDS: about 0.88 at s = 0.5, 0.12 at s = 0.2.
+const size_t MINHASH_BANDS = 16;
+const size_t MINHASH_ROWS = 3;
+const size_t MINHASH_HASHES = MINHASH_BANDS * MINHASH_ROWS;
+
+// Users with the same band are candidates of each other; in a larger bucket each
+// user only takes this many of its neighbours in bucket order, so users with one
+// shared follower cannot make the work quadratic
+const size_t MINHASH_BUCKET_WINDOW = 64;
+
+// MinHash signatures of every user's follower set, bucketed by band (LSH). Followers
+// are hashed by external id, so the sketch does not depend on the dense layout.
+// Users with no followers have no signature and are in no bucket.
+class AudienceSketch {
+private:
+    size_t user_Count = 0;
+    size_t signed_Count = 0;
+    vector<uint32_t> user_Signatures;  // MINHASH_HASHES per user
+    vector<char> user_Signed;          // user has followers
+    vector<uint32_t> band_Members;     // per band, the signed users ordered by band key, then external id
+    vector<uint32_t> band_Positions;   // per band, where each user is in band_Members
+
+    uint64_t bandKey(uint32_t user, size_t band) const;
+    bool sameBand(uint32_t a, uint32_t b, size_t band) const;
+
+public:
+    // Graph is a SocialIndex or a CompactGraph (compact_graph.h)
+    template <typename Graph>
+    void build(const Graph &graph, int threads = 1);
+
+    // Users sharing a band with user; one sharing several bands is listed once per band
+    void candidates(uint32_t user, vector<uint32_t> &result) const;
+
+    // Fraction of equal minimum hashes, an estimate of the Jaccard similarity of
+    // the two follower sets
+    double similarity(uint32_t a, uint32_t b) const;
+};
+
+// Users whose followers overlap user's followers, except itself and the users it
+// already follows. Best first: higher estimated similarity, then lower external id.
+template <typename Graph>
+void suggestSimilarUsers(const AudienceSketch &sketch, const Graph &graph, uint32_t user, size_t limit,
+                         SuggestScratch &scratch, vector<uint32_t> &result);
+
+#endif
@@ -0,0 +1,54 @@
+#include "parallel.h"
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+int resolveThreadCount(int requested)
+{
+    if (requested > 0)
+        return requested;
+
+    unsigned int cores = thread::hardware_concurrency();
+    return cores == 0 ? 1 : (int)cores;
+}
+
+void parallelFor(size_t count, int threads, const function<void(size_t, size_t, int)> &body)
+{
+    if (count == 0)
+        return;
+
+    size_t workers = (size_t)resolveThreadCount(threads);
+    if (workers > count)
+        workers = count;
+
+    // Nothing to gain from spawning a thread for a single range
+    if (workers == 1)
+    {
+        body(0, count, 0);
+        return;
+    }
+
+    vector<thread> pool;
+    pool.reserve(workers - 1);
+
+    size_t chunk = count / workers;
+    size_t extra = count % workers;
+    size_t begin = 0;
+
+    for (size_t w = 0; w < workers; ++w)
+    {
+        size_t end = begin + chunk + (w < extra ? 1 : 0);
+
+        // The calling thread takes the last range itself
+        if (w + 1 == workers)
+            body(begin, end, (int)w);
+        else
+            pool.emplace_back(body, begin, end, (int)w);
+
+        begin = end;
+    }
+
+    for (auto &t : pool)
+        t.join();
+}
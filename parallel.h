@@ -0,0 +1,16 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <cstddef>
+#include <functional>
+
+using namespace std;
+
+// Number of worker threads to use; 0 or less means "all cores"
+int resolveThreadCount(int requested);
+
+// Split [0, count) into one contiguous range per worker and run body on each.
+// body(begin, end, worker) is called from worker threads; it returns when all are done.
+void parallelFor(size_t count, int threads, const function<void(size_t, size_t, int)> &body);
+
+#endif
@@ -0,0 +1,104 @@
+#include "recommend.h"
+#include "compact_graph.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+bool parseSuggestWeighting(const string &name, SuggestWeighting &weighting)
+{
+    if (name == "common")
+        weighting = SUGGEST_COMMON;
+    else if (name == "adamic-adar")
+        weighting = SUGGEST_ADAMIC_ADAR;
+    else if (name == "jaccard")
+        weighting = SUGGEST_JACCARD;
+    else if (name == "minhash")
+        weighting = SUGGEST_MINHASH;
+    else
+        return false;
+    return true;
+}
+
+void SuggestScratch::resize(size_t users)
+{
+    count.assign(users, 0);
+    weight.assign(users, 0);
+    excluded.assign(users, 0);
+}
+
+template <typename Graph>
+void suggestUsers(const Graph &index, uint32_t user, const SuggestOptions &options,
+                  SuggestScratch &scratch, vector<uint32_t> &result)
+{
+    result.clear();
+    auto myFollowing = index.following(user);
+    if (myFollowing.empty())
+        return;
+
+    for (uint32_t id : myFollowing)
+        scratch.excluded[id] = 1;
+    scratch.excluded[user] = 1;
+
+    // One pass over the friends of friends; result doubles as the touched list
+    for (uint32_t friendId : myFollowing)
+    {
+        auto friendsFollowing = index.following(friendId);
+        double friendWeight = options.weighting == SUGGEST_ADAMIC_ADAR ? 1.0 / log(1.0 + friendsFollowing.size()) : 0;
+
+        for (uint32_t candidate : friendsFollowing)
+        {
+            if (scratch.excluded[candidate])
+                continue;
+            if (scratch.count[candidate]++ == 0)
+                result.push_back(candidate);
+            scratch.weight[candidate] += friendWeight;
+        }
+    }
+
+    if (options.weighting == SUGGEST_JACCARD)
+    {
+        for (uint32_t candidate : result)
+        {
+            double common = scratch.count[candidate];
+            scratch.weight[candidate] = common / (myFollowing.size() + index.sortedFollowers(candidate).size() - common);
+        }
+    }
+
+    const bool byCount = options.weighting == SUGGEST_COMMON;
+    const vector<uint32_t> &count = scratch.count;
+    const vector<double> &weight = scratch.weight;
+    auto better = [&](uint32_t a, uint32_t b)
+    {
+        if (byCount ? count[a] != count[b] : weight[a] != weight[b])
+            return byCount ? count[a] > count[b] : weight[a] > weight[b];
+        return index.externalId(a) < index.externalId(b);
+    };
+
+    // Only the best candidates need an order: select them first, then sort just those
+    if (options.limit > 0 && result.size() > options.limit)
+    {
+        nth_element(result.begin(), result.begin() + options.limit, result.end(), better);
+        for (auto it = result.begin() + options.limit; it != result.end(); ++it)
+        {
+            scratch.count[*it] = 0;
+            scratch.weight[*it] = 0;
+        }
+        result.resize(options.limit);
+    }
+    sort(result.begin(), result.end(), better);
+
+    // Only the entries set above are cleared, so the next user starts from zero
+    for (uint32_t candidate : result)
+    {
+        scratch.count[candidate] = 0;
+        scratch.weight[candidate] = 0;
+    }
+    for (uint32_t id : myFollowing)
+        scratch.excluded[id] = 0;
+    scratch.excluded[user] = 0;
+}
+
+template void suggestUsers(const SocialIndex &, uint32_t, const SuggestOptions &, SuggestScratch &, vector<uint32_t> &);
+template void suggestUsers(const CompactGraph &, uint32_t, const SuggestOptions &, SuggestScratch &, vector<uint32_t> &);
@@ -0,0 +1,55 @@
+#ifndef RECOMMEND_H
+#define RECOMMEND_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "social_index.h"
+
+using namespace std;
+
+// How a candidate is scored from the followed users ("friends") that follow it:
+//   common      : number of friends following it
+//   adamic-adar : sum over those friends of 1 / log(1 + users the friend follows),
+//                 so friends who follow few users count more
+//   jaccard     : common / |users followed  U  candidate's followers|
+// minhash does not use friends of friends: it suggests users whose followers
+// overlap the user's own followers, estimated by MinHash (minhash.h)
+enum SuggestWeighting
+{
+    SUGGEST_COMMON,
+    SUGGEST_ADAMIC_ADAR,
+    SUGGEST_JACCARD,
+    SUGGEST_MINHASH
+};
+
+// Parses "common", "adamic-adar", "jaccard" or "minhash"; false for anything else
+bool parseSuggestWeighting(const string &name, SuggestWeighting &weighting);
+
+struct SuggestOptions
+{
+    SuggestWeighting weighting = SUGGEST_COMMON;
+    size_t limit = 0;  // best K only; 0 keeps every candidate
+};
+
+// Scratch space one thread reuses for every user it scores: dense arrays over all
+// users, of which only the entries the last user touched are reset
+struct SuggestScratch
+{
+    vector<uint32_t> count;
+    vector<double> weight;
+    vector<char> excluded;
+
+    void resize(size_t users);
+};
+
+// Users followed by the users this user follows, except the ones it already
+// follows and itself. Best first: higher score, then lower external id.
+// With a limit only the best candidates are selected and sorted.
+// Graph is a SocialIndex or a CompactGraph (compact_graph.h).
+template <typename Graph>
+void suggestUsers(const Graph &index, uint32_t user, const SuggestOptions &options,
+                  SuggestScratch &scratch, vector<uint32_t> &result);
+
+#endif
@@ -0,0 +1,489 @@
+#include "server.h"
+#include "functions.h"
+#include "minhash.h"
+#include "recommend.h"
+#include "parallel.h"
+#include "utils.h"
+
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <iostream>
+#include <mutex>
+#include <shared_mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// ==================== Requests ====================
+
+static string joinPosts(const vector<string> &posts)
+{
+    string result;
+    for (const string &post : posts)
+        result += post + "\n";
+    return result;
+}
+
+// A K argument: decimal digits only, so a misspelt option is not read as 0
+static size_t parseCount(const string &token)
+{
+    if (token.empty() || token.find_first_not_of("0123456789") != string::npos)
+        throw invalid_argument("'" + token + "' is not a count");
+    return stoul(token);
+}
+
+// Readers of the index, or the one delta being applied to it
+static shared_mutex indexLock;
+
+// MinHash signatures of the index: built by the first minhash request, on the
+// server's threads, and dropped by apply-delta while it holds indexLock alone
+static shared_ptr<const AudienceSketch> indexSketch;
+static mutex sketchLock;
+
+// The caller holds indexLock as a reader; other minhash requests wait for the build
+static shared_ptr<const AudienceSketch> sketchOf(const SocialIndex &index, int threads)
+{
+    lock_guard<mutex> guard(sketchLock);
+    if (!indexSketch)
+    {
+        auto sketch = make_shared<AudienceSketch>();
+        sketch->build(index, threads);
+        indexSketch = sketch;
+    }
+    return indexSketch;
+}
+
+static string applyDeltaFile(SocialIndex &index, const string &path)
+{
+    string delta;
+    if (path.empty() || !extract_content(path, delta))
+        throw invalid_argument("cannot read delta file '" + path + "'");
+
+    unique_lock<shared_mutex> writer(indexLock);
+    DeltaSummary summary;
+    if (!index.applyDelta(delta, summary))
+        throw invalid_argument("delta file '" + path + "' has no <add> or <remove> section");
+    indexSketch.reset();
+
+    stringstream out;
+    out << "users +" << summary.usersAdded << " -" << summary.usersRemoved << ", follows +" << summary.followsAdded
+        << " -" << summary.followsRemoved << ", posts +" << summary.postsAdded << " -" << summary.postsRemoved << "\n";
+    return out.str();
+}
+
+string answerRequest(SocialIndex &index, const string &line, bool &ok, bool &stop, int threads)
+{
+    if (line.size() > SERVER_MAX_LINE)
+    {
+        ok = false;
+        return "request line longer than " + to_string(SERVER_MAX_LINE) + " bytes";
+    }
+
+    stringstream request(line);
+    string command;
+    request >> command;
+    ok = true;
+
+    string result;
+    try
+    {
+        if (command == "apply-delta")
+        {
+            string path;
+            getline(request >> ws, path);
+            result = applyDeltaFile(index, path);
+        }
+        else if (command == "ping")
+        {
+            result = "pong\n";
+        }
+        else if (command == "shutdown")
+        {
+            stop = true;
+            result = "bye\n";
+        }
+        else if (command == "mutual")
+        {
+            shared_lock<shared_mutex> reader(indexLock);
+            string ids;
+            request >> ids;
+            result = mutual(index, strIDs2int(ids));
+        }
+        else if (command == "suggest")
+        {
+            shared_lock<shared_mutex> reader(indexLock);
+            int id;
+            if (!(request >> id))
+                throw invalid_argument("suggest needs a user id");
+
+            // Optional K, then an optional score; each token must be one of them
+            size_t limit = 0;
+            string weighting = "common", token;
+            bool haveLimit = false, haveWeighting = false;
+            SuggestWeighting parsed = SUGGEST_COMMON;
+            while (request >> token)
+            {
+                if (!haveLimit && !haveWeighting && isdigit((unsigned char)token[0]))
+                {
+                    limit = parseCount(token);
+                    haveLimit = true;
+                }
+                else if (!haveWeighting && parseSuggestWeighting(token, parsed))
+                {
+                    weighting = token;
+                    haveWeighting = true;
+                }
+                else
+                {
+                    throw invalid_argument("unexpected '" + token + "' (suggest ID [K] [common|adamic-adar|jaccard|minhash])");
+                }
+            }
+            if (parsed == SUGGEST_MINHASH)
+                result = suggest(index, id, limit, weighting, *sketchOf(index, threads));
+            else
+                result = suggest(index, id, limit, weighting);
+        }
+        else if (command == "search")
+        {
+            shared_lock<shared_mutex> reader(indexLock);
+            string kind, text;
+            request >> kind;
+            getline(request >> ws, text);
+            if (kind == "word")
+                result = joinPosts(searchPostsByWord(index, text));
+            else if (kind == "topic")
+                result = joinPosts(searchPostsByTopic(index, text));
+            else
+                throw invalid_argument("search needs 'word' or 'topic'");
+        }
+        else if (command == "most_active" || command == "most_influencer")
+        {
+            shared_lock<shared_mutex> reader(indexLock);
+            size_t topK = 0;
+            string token;
+            if (request >> token)
+                topK = parseCount(token);
+            if (request >> token)
+                throw invalid_argument("unexpected '" + token + "'");
+            result = command == "most_active" ? most_active(index, topK) : most_influencer(index, topK);
+        }
+        else if (command == "path")
+        {
+            shared_lock<shared_mutex> reader(indexLock);
+            int from, to;
+            string direction = "following";
+            if (!(request >> from >> to))
+                throw invalid_argument("path needs two user ids");
+            request >> direction;
+            result = shortest_path(index, {from, to}, direction);
+        }
+        else
+        {
+            throw invalid_argument("unknown request '" + command + "'");
+        }
+    }
+    catch (const exception &e)
+    {
+        ok = false;
+        return "bad request '" + line + "': " + e.what();
+    }
+
+    // The analytics report bad input in their result text
+    if (result.compare(0, 7, "Error: ") == 0)
+    {
+        ok = false;
+        return result.substr(7);
+    }
+    return result;
+}
+
+// ==================== Server ====================
+
+#ifdef _WIN32
+
+bool serveRequests(SocialIndex &, const string &, int)
+{
+    cerr << "Error: serve needs Unix domain sockets, which this build does not support" << endl;
+    return false;
+}
+
+#else
+
+static bool sendAll(int fd, const string &data)
+{
+    size_t sent = 0;
+    while (sent < data.size())
+    {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0)
+            return false;
+        sent += n;
+    }
+    return true;
+}
+
+// Takes the next non-empty line out of a connection's input, if a whole one arrived
+static bool nextLine(string &pending, string &line)
+{
+    size_t newline;
+    while ((newline = pending.find('\n')) != string::npos)
+    {
+        line = pending.substr(0, newline);
+        pending.erase(0, newline + 1);
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (!line.empty())
+            return true;
+    }
+    return false;
+}
+
+// A client connection; only one of its lines is answered at a time, so replies
+// keep the order of the requests
+struct ClientConnection
+{
+    string pending;        // received, not yet answered
+    bool busy = false;     // a worker is answering one of its lines
+    bool skipping = false; // dropping the rest of an overlong line
+};
+
+// Adds received bytes to a connection's input. A line without a newline cannot
+// grow past SERVER_MAX_LINE + 1 bytes: the rest of it is dropped, and the part
+// kept is still too long, so the line gets an ERR answer in its turn.
+static void receiveInput(ClientConnection &connection, const char *data, size_t size)
+{
+    if (connection.skipping)
+    {
+        const char *newline = (const char *)memchr(data, '\n', size);
+        if (!newline)
+            return;
+        connection.skipping = false;
+        connection.pending += '\n';
+        size -= newline + 1 - data;
+        data = newline + 1;
+    }
+    connection.pending.append(data, size);
+
+    size_t lineStart = connection.pending.rfind('\n');
+    lineStart = lineStart == string::npos ? 0 : lineStart + 1;
+    if (connection.pending.size() - lineStart > SERVER_MAX_LINE)
+    {
+        connection.pending.resize(lineStart + SERVER_MAX_LINE + 1);
+        connection.skipping = true;
+    }
+}
+
+// One line for the pool
+struct ServerJob
+{
+    int fd;
+    string line;
+};
+
+bool serveRequests(SocialIndex &index, const string &socketPath, int threads)
+{
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path))
+    {
+        cerr << "Error: Socket path is too long: " << socketPath << endl;
+        return false;
+    }
+    strcpy(address.sun_path, socketPath.c_str());
+
+    // A socket left behind by an earlier server is replaced; any other file is not
+    struct stat info;
+    if (stat(socketPath.c_str(), &info) == 0 && S_ISSOCK(info.st_mode))
+        unlink(socketPath.c_str());
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0 || bind(listener, (sockaddr *)&address, sizeof(address)) != 0 || listen(listener, 64) != 0)
+    {
+        cerr << "Error: Cannot listen on " << socketPath << ": " << strerror(errno) << endl;
+        if (listener >= 0)
+            close(listener);
+        return false;
+    }
+
+    // Workers write a byte here when they finish a line, so poll() wakes up to
+    // watch that connection again (or to stop after a shutdown request)
+    int wake[2];
+    if (pipe(wake) != 0)
+    {
+        cerr << "Error: Cannot create wake-up pipe: " << strerror(errno) << endl;
+        close(listener);
+        return false;
+    }
+
+    // Lines wait in jobs for a free worker; answered connections come back in done
+    deque<ServerJob> jobs;
+    deque<pair<int, bool>> done; // fd, still open
+    mutex lock;
+    condition_variable ready;
+    atomic<bool> stopping(false);
+    bool closed = false;
+
+    int workers = resolveThreadCount(threads);
+    vector<thread> pool;
+    for (int w = 0; w < workers; ++w)
+    {
+        pool.emplace_back([&]
+        {
+            while (true)
+            {
+                ServerJob job;
+                {
+                    unique_lock<mutex> guard(lock);
+                    ready.wait(guard, [&] { return closed || !jobs.empty(); });
+                    if (jobs.empty())
+                        return;
+                    job = move(jobs.front());
+                    jobs.pop_front();
+                }
+
+                bool ok, stop = false;
+                string answer = answerRequest(index, job.line, ok, stop, workers);
+                string reply = ok ? "OK " + to_string(answer.size()) + "\n" + answer : "ERR " + answer + "\n";
+                bool open = sendAll(job.fd, reply) && !stop;
+                if (stop)
+                    stopping = true;
+
+                {
+                    lock_guard<mutex> guard(lock);
+                    done.push_back({job.fd, open});
+                }
+                char byte = 0;
+                while (write(wake[1], &byte, 1) < 0 && errno == EINTR)
+                {
+                }
+            }
+        });
+    }
+
+    cout << "Serving " << index.userCount() << " users on " << socketPath << " with " << workers
+         << " threads." << endl;
+
+    // The main thread only waits on sockets: it reads idle connections and hands
+    // each complete line to the pool, so an idle client never holds a worker
+    map<int, ClientConnection> connections;
+    auto closeConnection = [&](int fd)
+    {
+        close(fd);
+        connections.erase(fd);
+    };
+
+    vector<pollfd> watched;
+    char buffer[4096];
+    while (true)
+    {
+        {
+            lock_guard<mutex> guard(lock);
+            for (auto [fd, open] : done)
+            {
+                connections[fd].busy = false;
+                if (!open)
+                    closeConnection(fd);
+            }
+            done.clear();
+        }
+
+        // After a shutdown request no more input is read, but every line already
+        // received is answered before the connections are closed
+        size_t busy = 0;
+        for (auto &[fd, connection] : connections)
+        {
+            string line;
+            if (!connection.busy && nextLine(connection.pending, line))
+            {
+                connection.busy = true;
+                lock_guard<mutex> guard(lock);
+                jobs.push_back({fd, move(line)});
+                ready.notify_one();
+            }
+            busy += connection.busy;
+        }
+        if (stopping && busy == 0)
+            break;
+
+        watched.assign(1, {wake[0], POLLIN, 0});
+        if (!stopping)
+        {
+            watched.push_back({listener, POLLIN, 0});
+            for (const auto &[fd, connection] : connections)
+                if (!connection.busy)
+                    watched.push_back({fd, POLLIN, 0});
+        }
+
+        if (poll(watched.data(), watched.size(), -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            cerr << "Error: poll failed: " << strerror(errno) << endl;
+            stopping = true;
+            continue;
+        }
+
+        if (watched[0].revents & POLLIN)
+        {
+            while (read(wake[0], buffer, sizeof(buffer)) < 0 && errno == EINTR)
+            {
+            }
+        }
+        if (stopping)
+            continue;
+
+        if (watched[1].revents & POLLIN)
+        {
+            int fd = accept(listener, nullptr, nullptr);
+            if (fd >= 0)
+                connections[fd];
+        }
+
+        for (size_t w = 2; w < watched.size(); ++w)
+        {
+            if (!watched[w].revents)
+                continue;
+            ssize_t n = recv(watched[w].fd, buffer, sizeof(buffer), 0);
+            if (n > 0)
+                receiveInput(connections[watched[w].fd], buffer, n);
+            else if (n == 0 || errno != EINTR)
+                closeConnection(watched[w].fd);
+        }
+    }
+
+    {
+        lock_guard<mutex> guard(lock);
+        closed = true;
+        ready.notify_all();
+    }
+    for (auto &t : pool)
+        t.join();
+
+    for (const auto &entry : connections)
+        close(entry.first);
+    close(wake[0]);
+    close(wake[1]);
+    close(listener);
+    unlink(socketPath.c_str());
+    cout << "Server stopped." << endl;
+    return true;
+}
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <string>
+
+#include "social_index.h"
+
+using namespace std;
+
+// Query daemon: keeps one SocialIndex in memory and answers requests sent over a
+// Unix domain socket. Each request is one line; each answer is either
+//   "OK <length>\n" followed by <length> bytes of result, or
+//   "ERR <message>\n".
+// Requests:
+//   mutual ID,ID,...               suggest ID [K] [common|adamic-adar|jaccard|minhash]
+//   search word TEXT               search topic TEXT
+//   most_active [K]                most_influencer [K]
+//   path ID ID [following|followers|any]
+//   apply-delta PATH               patches the index with a delta file (SocialIndex::applyDelta)
+//   ping                           shutdown (stops reading; lines already received are answered)
+// A line longer than SERVER_MAX_LINE bytes is answered with ERR; only its first
+// SERVER_MAX_LINE + 1 bytes are kept while the rest is skipped up to its newline.
+const char *const SERVER_DEFAULT_SOCKET = "xml_editor.sock";
+const size_t SERVER_MAX_LINE = 64 * 1024;
+
+// Answers one request line; ok is false for an ERR answer, stop is set by shutdown.
+// Queries share the index; apply-delta waits until it is the only request running.
+// The first minhash suggestion builds the MinHash signatures of the index on
+// threads workers; later ones reuse them until an apply-delta.
+string answerRequest(SocialIndex &index, const string &line, bool &ok, bool &stop, int threads = 1);
+
+// Listens on socketPath and answers request lines on a pool of threads (0 => all cores)
+// until a shutdown request; false if the socket cannot be opened. Connections are
+// watched with poll(), so any number of idle clients hold no thread.
+bool serveRequests(SocialIndex &index, const string &socketPath, int threads);
+
+#endif
@@ -0,0 +1,1355 @@
+#include "social_index.h"
+
+#include "compact_graph.h"
+#include "compression.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// ==================== Scanning ====================
+
+// Parses a user id, ignoring surrounding whitespace; false if it is not a number
+static bool parseUserId(const char *first, const char *last, int &id)
+{
+    while (first < last && strchr(" \t\r\n", *first))
+        first++;
+    while (last > first && strchr(" \t\r\n", last[-1]))
+        last--;
+    if (first == last)
+        return false;
+    auto parsed = from_chars(first, last, id);
+    return parsed.ec == errc() && parsed.ptr == last;
+}
+
+static bool tagIs(const char *name, size_t length, const char *expected)
+{
+    return length == strlen(expected) && memcmp(name, expected, length) == 0;
+}
+
+// Finds the next tag at or after p: name points at its name (without '/'),
+// p moves past the '>'. False when no complete tag is left.
+struct ScannedTag
+{
+    const char *start;  // the '<'
+    const char *name;
+    size_t length;
+    bool closing;
+};
+
+static bool nextTag(const char *&p, const char *end, ScannedTag &tag)
+{
+    p = (const char *)memchr(p, '<', end - p);
+    if (!p)
+        return false;
+
+    tag.start = p;
+    tag.name = p + 1;
+    tag.closing = tag.name < end && *tag.name == '/';
+    if (tag.closing)
+        tag.name++;
+
+    const char *close = (const char *)memchr(tag.name, '>', end - tag.name);
+    if (!close)
+        return false;
+    tag.length = close - tag.name;
+    p = close + 1;
+    return true;
+}
+
+void scanUserRecords(const string &xml, const function<void(const UserSummary &)> &visit)
+{
+    const char *p = xml.data();
+    const char *end = p + xml.size();
+    const char *contentStart = p;
+
+    UserSummary user;
+    bool inUser = false, inFollowers = false, hasId = false, hasName = false;
+
+    ScannedTag tag;
+    while (nextTag(p, end, tag))
+    {
+        if (!tag.closing)
+        {
+            contentStart = p;
+            if (tagIs(tag.name, tag.length, "user"))
+            {
+                user = UserSummary();
+                inUser = true;
+                inFollowers = hasId = hasName = false;
+            }
+            else if (!inUser)
+                continue;
+            else if (tagIs(tag.name, tag.length, "post"))
+                user.postCount++;
+            else if (tagIs(tag.name, tag.length, "follower"))
+                user.followerCount++;
+            else if (tagIs(tag.name, tag.length, "followers"))
+                inFollowers = true;
+            continue;
+        }
+
+        if (!inUser)
+            continue;
+
+        if (tagIs(tag.name, tag.length, "id"))
+        {
+            if (!inFollowers && !hasId)
+            {
+                hasId = true;
+                user.id = string_view(contentStart, tag.start - contentStart);
+            }
+        }
+        else if (tagIs(tag.name, tag.length, "name"))
+        {
+            if (!inFollowers && !hasName)
+            {
+                hasName = true;
+                user.name = string_view(contentStart, tag.start - contentStart);
+            }
+        }
+        else if (tagIs(tag.name, tag.length, "followers"))
+        {
+            inFollowers = false;
+        }
+        else if (tagIs(tag.name, tag.length, "user"))
+        {
+            visit(user);
+            inUser = false;
+        }
+    }
+}
+
+// ==================== Building ====================
+
+// Collects records, posts and follower edges in document order, then lays them
+// out as the index arrays. build() fills it from a document, applyDelta() from
+// the current index and a delta.
+struct IndexBuilder
+{
+    vector<SocialRecord> records;
+    vector<SocialPost> posts;
+    vector<uint32_t> postTopics;
+    vector<char> topicPool, textPool;
+    vector<uint64_t> topicOffsets = vector<uint64_t>(1, 0);
+    vector<int> userIds;
+    unordered_map<int, uint32_t> userLookup;
+    unordered_map<string_view, uint32_t> topicLookup;  // views into the source, not the pools
+
+    // (dense user, follower id) pairs in document order. Follower ids are interned
+    // by finish(), so users with a record get the first dense ids.
+    vector<pair<uint32_t, int>> edges;
+
+    uint32_t internUser(int id)
+    {
+        auto inserted = userLookup.emplace(id, (uint32_t)userIds.size());
+        if (inserted.second)
+            userIds.push_back(id);
+        return inserted.first->second;
+    }
+
+    // Copies text into the text pool, returns its offset
+    uint64_t pool(string_view text)
+    {
+        uint64_t offset = textPool.size();
+        textPool.insert(textPool.end(), text.begin(), text.end());
+        return offset;
+    }
+
+    uint32_t internTopic(string_view topic)
+    {
+        auto found = topicLookup.find(topic);
+        if (found == topicLookup.end())
+        {
+            found = topicLookup.emplace(topic, (uint32_t)topicOffsets.size() - 1).first;
+            topicPool.insert(topicPool.end(), topic.begin(), topic.end());
+            topicOffsets.push_back(topicPool.size());
+        }
+        return found->second;
+    }
+
+    // Lays the collected records and edges out in index; with coded, the lists are
+    // only kept varint-coded, on up to threads workers (see buildCoded). False, with
+    // index untouched, if there are more edges than the 32-bit list offsets can hold.
+    bool finish(SocialIndex &index, bool coded = false, int threads = 1);
+};
+
+bool IndexBuilder::finish(SocialIndex &index, bool coded, int threads)
+{
+    if (edges.size() > UINT32_MAX)
+    {
+        cerr << "Error: " << edges.size() << " follows do not fit the 32-bit list offsets of the index (at most "
+             << UINT32_MAX << ")" << endl;
+        return false;
+    }
+
+    // Follower ids become dense ids in place, in document order
+    for (auto &edge : edges)
+        edge.second = (int)internUser(edge.second);
+
+    // Followers CSR: a stable counting sort keeps document order within each list
+    size_t users = userIds.size();
+    vector<uint32_t> followerOffsets(users + 1, 0);
+    for (const auto &edge : edges)
+        followerOffsets[edge.first + 1]++;
+    for (size_t u = 0; u < users; ++u)
+        followerOffsets[u + 1] += followerOffsets[u];
+
+    vector<uint32_t> followerIds(edges.size());
+    vector<uint32_t> next(followerOffsets.begin(), followerOffsets.end() - 1);
+    for (const auto &edge : edges)
+        followerIds[next[edge.first]++] = (uint32_t)edge.second;
+    vector<pair<uint32_t, int>>().swap(edges);
+
+    // Following CSR: the transpose, filled in user order
+    vector<uint32_t> followingOffsets(users + 1, 0);
+    for (uint32_t follower : followerIds)
+        followingOffsets[follower + 1]++;
+    for (size_t u = 0; u < users; ++u)
+        followingOffsets[u + 1] += followingOffsets[u];
+
+    vector<uint32_t> followingIds(followerIds.size());
+    next.assign(followingOffsets.begin(), followingOffsets.end() - 1);
+    for (uint32_t u = 0; u < users; ++u)
+    {
+        for (uint32_t e = followerOffsets[u]; e < followerOffsets[u + 1]; ++e)
+            followingIds[next[followerIds[e]]++] = u;
+    }
+    vector<uint32_t>().swap(next);
+
+    // Id lookup table: user ids in order, with their dense ids
+    vector<uint32_t> byId(users);
+    for (uint32_t u = 0; u < users; ++u)
+        byId[u] = u;
+    sort(byId.begin(), byId.end(), [&](uint32_t a, uint32_t b) { return userIds[a] < userIds[b]; });
+    vector<int> lookupIds(users);
+    for (size_t i = 0; i < users; ++i)
+        lookupIds[i] = userIds[byId[i]];
+
+    index = SocialIndex();
+    index.index_Records.adopt(move(records));
+    index.index_Posts.adopt(move(posts));
+    index.post_Topics.adopt(move(postTopics));
+    index.topic_Pool.adopt(move(topicPool));
+    index.topic_Offsets.adopt(move(topicOffsets));
+    index.text_Pool.adopt(move(textPool));
+    index.user_Ids.adopt(move(userIds));
+    index.lookup_Ids.adopt(move(lookupIds));
+    index.lookup_Users.adopt(move(byId));
+
+    if (coded)
+    {
+        // Each sorted list is made in the worker's scratch, just before it is coded
+        CompactLists lists;
+        auto listsOf = [&](uint32_t u, vector<uint32_t> &scratch)
+        {
+            const uint32_t *followerBase = followerIds.data(), *followingBase = followingIds.data();
+            scratch.assign(followerBase + followerOffsets[u], followerBase + followerOffsets[u + 1]);
+            sort(scratch.begin(), scratch.end());
+            scratch.erase(unique(scratch.begin(), scratch.end()), scratch.end());
+            return UserLists{{followerBase + followerOffsets[u], followerBase + followerOffsets[u + 1]},
+                             {followingBase + followingOffsets[u], followingBase + followingOffsets[u + 1]},
+                             {scratch.data(), scratch.data() + scratch.size()}};
+        };
+        if (!encodeCompactLists(users, threads, listsOf, nullptr, lists))
+            return false;
+        index.coded_Lists.adopt(move(lists.bytes));
+        index.coded_Blocks.adopt(move(lists.blocks));
+        index.coded_Offsets.adopt(move(lists.offsets));
+        return true;
+    }
+
+    // Sorted, repeat-free follower lists
+    vector<uint32_t> sortedOffsets(users + 1, 0), sortedFollowers;
+    sortedFollowers.reserve(followerIds.size());
+    for (uint32_t u = 0; u < users; ++u)
+    {
+        size_t first = sortedFollowers.size();
+        sortedFollowers.insert(sortedFollowers.end(), followerIds.begin() + followerOffsets[u],
+                               followerIds.begin() + followerOffsets[u + 1]);
+        sort(sortedFollowers.begin() + first, sortedFollowers.end());
+        sortedFollowers.erase(unique(sortedFollowers.begin() + first, sortedFollowers.end()), sortedFollowers.end());
+        sortedOffsets[u + 1] = (uint32_t)sortedFollowers.size();
+    }
+
+    index.follower_Offsets.adopt(move(followerOffsets));
+    index.follower_Ids.adopt(move(followerIds));
+    index.following_Offsets.adopt(move(followingOffsets));
+    index.following_Ids.adopt(move(followingIds));
+    index.sorted_Offsets.adopt(move(sortedOffsets));
+    index.sorted_Followers.adopt(move(sortedFollowers));
+    return true;
+}
+
+// Collects the records, posts and follower edges of a document into builder
+static void scanIndex(const string &xml, IndexBuilder &builder)
+{
+    const char *data = xml.data();
+    const char *end = data + xml.size();
+
+    vector<int> recordFollowers;
+
+    bool inUser = false, inFollowers = false, inFollower = false, inPost = false;
+    bool hasId = false, hasName = false, followerHasId = false;
+    int recordId = 0;
+    bool recordIdValid = false;
+    SocialRecord record;
+    const char *contentStart = nullptr;  // text after the last opening tag
+    const char *followerStart = nullptr;
+
+    const char *p = data;
+    ScannedTag tag;
+    while (nextTag(p, end, tag))
+    {
+        if (!tag.closing)
+        {
+            contentStart = p;
+            if (tagIs(tag.name, tag.length, "user"))
+            {
+                inUser = true;
+                inFollowers = inFollower = inPost = false;
+                hasId = hasName = recordIdValid = false;
+                record = SocialRecord();
+                record.postBegin = record.postEnd = (uint32_t)builder.posts.size();
+                recordFollowers.clear();
+            }
+            else if (!inUser)
+            {
+                continue;
+            }
+            else if (tagIs(tag.name, tag.length, "followers"))
+            {
+                inFollowers = true;
+            }
+            else if (tagIs(tag.name, tag.length, "follower"))
+            {
+                inFollower = true;
+                followerHasId = false;
+                followerStart = p;
+                record.followerCount++;
+            }
+            else if (tagIs(tag.name, tag.length, "post"))
+            {
+                inPost = true;
+                SocialPost post;
+                post.topicBegin = post.topicEnd = (uint32_t)builder.postTopics.size();
+                builder.posts.push_back(post);
+                record.postEnd++;
+            }
+            continue;
+        }
+
+        if (!inUser)
+            continue;
+
+        string_view content(contentStart, tag.start - contentStart);
+        if (tagIs(tag.name, tag.length, "id"))
+        {
+            int id;
+            if (inFollower)
+            {
+                followerHasId = true;
+                if (parseUserId(contentStart, tag.start, id))
+                    recordFollowers.push_back(id);
+            }
+            else if (!inFollowers && !hasId)
+            {
+                hasId = true;
+                record.idOffset = builder.pool(content);
+                record.idLength = content.size();
+                recordIdValid = parseUserId(contentStart, tag.start, recordId);
+            }
+        }
+        else if (tagIs(tag.name, tag.length, "name"))
+        {
+            if (!inFollowers && !hasName)
+            {
+                hasName = true;
+                record.nameOffset = builder.pool(content);
+                record.nameLength = content.size();
+            }
+        }
+        else if (tagIs(tag.name, tag.length, "follower"))
+        {
+            int id;
+            if (inFollower && !followerHasId && parseUserId(followerStart, tag.start, id))
+                recordFollowers.push_back(id);
+            inFollower = false;
+        }
+        else if (tagIs(tag.name, tag.length, "followers"))
+        {
+            inFollowers = inFollower = false;
+        }
+        else if (tagIs(tag.name, tag.length, "body"))
+        {
+            if (inPost)
+            {
+                builder.posts.back().bodyOffset = builder.pool(content);
+                builder.posts.back().bodyLength = content.size();
+            }
+        }
+        else if (tagIs(tag.name, tag.length, "topic"))
+        {
+            if (inPost)
+            {
+                builder.postTopics.push_back(builder.internTopic(content));
+                builder.posts.back().topicEnd = (uint32_t)builder.postTopics.size();
+            }
+        }
+        else if (tagIs(tag.name, tag.length, "post"))
+        {
+            inPost = false;
+        }
+        else if (tagIs(tag.name, tag.length, "user"))
+        {
+            if (recordIdValid)
+            {
+                record.user = builder.internUser(recordId);
+                for (int follower : recordFollowers)
+                    builder.edges.push_back({record.user, follower});
+            }
+            builder.records.push_back(record);
+            inUser = false;
+        }
+    }
+}
+
+bool SocialIndex::build(const string &xml)
+{
+    IndexBuilder builder;
+    scanIndex(xml, builder);
+    return builder.finish(*this);
+}
+
+bool SocialIndex::buildCoded(const string &xml, int threads)
+{
+    IndexBuilder builder;
+    scanIndex(xml, builder);
+    return builder.finish(*this, true, threads);
+}
+
+// ==================== Delta ====================
+
+// Text between the first <name> and the </name> after it
+static bool findSection(const string &xml, const string &name, string &text)
+{
+    size_t open = xml.find("<" + name + ">");
+    if (open == string::npos)
+        return false;
+    open += name.size() + 2;
+    size_t close = xml.find("</" + name + ">", open);
+    text = xml.substr(open, close == string::npos ? string::npos : close - open);
+    return true;
+}
+
+DeltaOverlay &SocialIndex::overlay()
+{
+    if (delta_Overlay)
+        return *delta_Overlay;
+
+    // One pass over the records finds each user's records; later deltas keep it current
+    delta_Overlay = make_unique<DeltaOverlay>();
+    DeltaOverlay &overlay = *delta_Overlay;
+    overlay.firstRecord.assign(user_Ids.size(), SOCIAL_NO_USER);
+    for (uint32_t r = 0; r < index_Records.size(); ++r)
+    {
+        uint32_t user = index_Records[r].user;
+        if (user == SOCIAL_NO_USER)
+            continue;
+        if (overlay.firstRecord[user] == SOCIAL_NO_USER)
+            overlay.firstRecord[user] = r;
+        else
+            overlay.laterRecords[user].push_back(r);
+    }
+
+    for (uint32_t t = 0; t + 1 < topic_Offsets.size(); ++t)
+        overlay.topicLookup.emplace(string(topicName(t)), t);
+    return overlay;
+}
+
+PatchedLists &SocialIndex::patchLists(uint32_t user)
+{
+    DeltaOverlay &patches = overlay();
+    auto found = patches.lists.find(user);
+    if (found != patches.lists.end())
+        return found->second;
+
+    PatchedLists copy;
+    AdjacencyRange followerList = followers(user), followingList = following(user), sortedList = sortedFollowers(user);
+    copy.followers.assign(followerList.begin(), followerList.end());
+    copy.following.assign(followingList.begin(), followingList.end());
+    copy.sorted.assign(sortedList.begin(), sortedList.end());
+    patches.copied += copy.followers.size() + copy.following.size() + copy.sorted.size();
+    patches.entries++;
+    return patches.lists.emplace(user, move(copy)).first->second;
+}
+
+SocialRecord &SocialIndex::patchRecord(uint32_t record)
+{
+    DeltaOverlay &patches = overlay();
+    auto found = patches.patchedRecords.find(record);
+    if (found != patches.patchedRecords.end())
+        return found->second;
+
+    patches.entries++;
+    const SocialRecord &current =
+        record < index_Records.size() ? index_Records[record] : patches.records[record - index_Records.size()];
+    return patches.patchedRecords.emplace(record, current).first->second;
+}
+
+// Live records of user, first one first
+vector<uint32_t> SocialIndex::recordsOf(uint32_t user) const
+{
+    vector<uint32_t> result;
+    if (delta_Overlay->firstRecord[user] == SOCIAL_NO_USER)
+        return result;
+    result.push_back(delta_Overlay->firstRecord[user]);
+    auto later = delta_Overlay->laterRecords.find(user);
+    if (later != delta_Overlay->laterRecords.end())
+        result.insert(result.end(), later->second.begin(), later->second.end());
+    return result;
+}
+
+// Dense id of id, given a new one (with empty lists) if it has none; a removed
+// user gets its old one back
+uint32_t SocialIndex::internUser(int id)
+{
+    DeltaOverlay &patches = overlay();
+    const int *found = lower_bound(lookup_Ids.begin(), lookup_Ids.end(), id);
+    if (found != lookup_Ids.end() && *found == id)
+    {
+        uint32_t user = lookup_Users[found - lookup_Ids.begin()];
+        patches.removedUsers.erase(user);
+        return user;
+    }
+
+    auto inserted = patches.userLookup.emplace(id, (uint32_t)userCount());
+    if (inserted.second)
+    {
+        patches.userIds.push_back(id);
+        patches.firstRecord.push_back(SOCIAL_NO_USER);
+        patches.lists[inserted.first->second];
+        patches.entries++;
+    }
+    patches.removedUsers.erase(inserted.first->second);
+    return inserted.first->second;
+}
+
+uint64_t SocialIndex::poolText(string_view text)
+{
+    DeltaOverlay &patches = overlay();
+    uint64_t offset = text_Pool.size() + patches.textPool.size();
+    patches.textPool.insert(patches.textPool.end(), text.begin(), text.end());
+    return offset;
+}
+
+uint32_t SocialIndex::internTopic(string_view topic)
+{
+    DeltaOverlay &patches = overlay();
+    auto found = patches.topicLookup.find(string(topic));
+    if (found != patches.topicLookup.end())
+        return found->second;
+
+    uint32_t id = (uint32_t)topicCount();
+    patches.topicPool.insert(patches.topicPool.end(), topic.begin(), topic.end());
+    patches.topicOffsets.push_back(patches.topicPool.size());
+    patches.topicLookup.emplace(string(topic), id);
+    return id;
+}
+
+// Drops every follow of user by follower; removed counts the follower entries dropped
+void SocialIndex::removeFollow(uint32_t user, uint32_t follower, size_t &removed)
+{
+    PatchedLists &target = patchLists(user);
+    size_t before = target.followers.size();
+    target.followers.erase(std::remove(target.followers.begin(), target.followers.end(), follower),
+                           target.followers.end());
+    removed = before - target.followers.size();
+    if (removed == 0)
+        return;
+    overlay().entries += 3;
+
+    auto sorted = lower_bound(target.sorted.begin(), target.sorted.end(), follower);
+    if (sorted != target.sorted.end() && *sorted == follower)
+        target.sorted.erase(sorted);
+
+    vector<uint32_t> &following = patchLists(follower).following;
+    auto run = equal_range(following.begin(), following.end(), user);
+    following.erase(run.first, run.second);
+}
+
+// Appends follower to user's followers, keeping the sorted lists in order
+void SocialIndex::addFollow(uint32_t user, uint32_t follower)
+{
+    PatchedLists &target = patchLists(user);
+    target.followers.push_back(follower);
+    auto sorted = lower_bound(target.sorted.begin(), target.sorted.end(), follower);
+    if (sorted == target.sorted.end() || *sorted != follower)
+        target.sorted.insert(sorted, follower);
+
+    vector<uint32_t> &following = patchLists(follower).following;
+    following.insert(upper_bound(following.begin(), following.end(), user), user);
+    overlay().entries += 3;
+}
+
+bool SocialIndex::applyDelta(const string &delta, DeltaSummary &summary)
+{
+    summary = DeltaSummary();
+
+    string addText, removeText;
+    bool hasAdd = findSection(delta, "add", addText);
+    bool hasRemove = findSection(delta, "remove", removeText);
+    if (!hasAdd && !hasRemove)
+    {
+        cerr << "Error: Delta has no <add> or <remove> section" << endl;
+        return false;
+    }
+
+    SocialIndex added, removed;
+    added.build(addText);
+    removed.build(removeText);
+    DeltaOverlay &patches = overlay();
+
+    // Lowers the follower count of user's first record, as the follows all belong to it
+    auto countFollowers = [&](uint32_t user, long change)
+    {
+        uint32_t first = patches.firstRecord[user];
+        if (first == SOCIAL_NO_USER)
+            return;
+        SocialRecord &record = patchRecord(first);
+        record.followerCount = (uint32_t)max<long>(0, (long)record.followerCount + change);
+    };
+
+    // Gives a record a new run of posts: the ones kept, then the ones added
+    auto copyPost = [&](const SocialIndex &from, const SocialPost &post)
+    {
+        SocialPost copy;
+        copy.bodyOffset = poolText(from.postBody(post));
+        copy.bodyLength = post.bodyLength;
+        copy.topicBegin = (uint32_t)(post_Topics.size() + patches.postTopics.size());
+        for (uint32_t topic : from.postTopics(post))
+            patches.postTopics.push_back(internTopic(from.topicName(topic)));
+        copy.topicEnd = (uint32_t)(post_Topics.size() + patches.postTopics.size());
+        patches.posts.push_back(copy);
+        patches.entries++;
+    };
+
+    // 1. Users given with only an <id> lose their records and every follow of them
+    unordered_set<uint32_t> dropped;
+    removed.forEachRecord([&](const SocialRecord &record)
+    {
+        uint32_t user = record.user == SOCIAL_NO_USER ? SOCIAL_NO_USER : find(removed.externalId(record.user));
+        if (user != SOCIAL_NO_USER && record.postBegin == record.postEnd && record.followerCount == 0)
+            dropped.insert(user);
+    });
+    summary.usersRemoved = dropped.size();
+
+    for (uint32_t user : dropped)
+    {
+        for (uint32_t r : recordsOf(user))
+            patches.removedRecords.insert(r);
+
+        AdjacencyRange followedList = following(user);
+        vector<uint32_t> followed(followedList.begin(), followedList.end());
+        followed.erase(unique(followed.begin(), followed.end()), followed.end());
+        for (uint32_t target : followed)
+        {
+            size_t count;
+            removeFollow(target, user, count);
+            if (!dropped.count(target))
+            {
+                summary.followsRemoved += count;
+                countFollowers(target, -(long)count);
+            }
+        }
+
+        PatchedLists &own = patchLists(user);
+        for (uint32_t follower : own.sorted)
+        {
+            vector<uint32_t> &list = patchLists(follower).following;
+            auto run = equal_range(list.begin(), list.end(), user);
+            list.erase(run.first, run.second);
+        }
+        patches.entries += own.followers.size() + own.sorted.size();
+        own.followers.clear();
+        own.sorted.clear();
+    }
+
+    // 2. Listed followers and posts of the other removed users
+    removed.forEachRecord([&](const SocialRecord &element)
+    {
+        if (element.user == SOCIAL_NO_USER)
+            return;
+        uint32_t user = find(removed.externalId(element.user));
+        if (user == SOCIAL_NO_USER || dropped.count(user))
+            return;
+
+        for (uint32_t follower : removed.sortedFollowers(element.user))
+        {
+            uint32_t followerUser = find(removed.externalId(follower));
+            size_t count = 0;
+            if (followerUser != SOCIAL_NO_USER && patches.firstRecord[user] != SOCIAL_NO_USER)
+                removeFollow(user, followerUser, count);
+            summary.followsRemoved += count;
+            countFollowers(user, -(long)count);
+        }
+
+        if (element.postBegin == element.postEnd)
+            return;
+        unordered_set<string_view> bodies;
+        for (const SocialPost &post : removed.recordPosts(element))
+            bodies.insert(removed.postBody(post));
+
+        for (uint32_t r : recordsOf(user))
+        {
+            SocialRecord &record = patchRecord(r);
+            PostRange old = recordPosts(record);
+            vector<SocialPost> kept;
+            for (const SocialPost &post : old)
+            {
+                if (bodies.count(postBody(post)))
+                    summary.postsRemoved++;
+                else
+                    kept.push_back(post);
+            }
+            if (kept.size() == old.size())
+                continue;
+
+            record.postBegin = (uint32_t)(index_Posts.size() + patches.posts.size());
+            patches.posts.insert(patches.posts.end(), kept.begin(), kept.end());
+            patches.entries += kept.size();
+            record.postEnd = (uint32_t)(index_Posts.size() + patches.posts.size());
+        }
+    });
+    for (uint32_t user : dropped)
+    {
+        patches.firstRecord[user] = SOCIAL_NO_USER;
+        patches.laterRecords.erase(user);
+        patches.removedUsers.insert(user);
+    }
+
+    // 3. Additions, once per user id, in the order the delta lists them: names,
+    //    posts and follows go to the user's first record; users without one get a
+    //    new record after every existing one
+    unordered_map<int, vector<const SocialRecord *>> additions;
+    vector<int> order;
+    added.forEachRecord([&](const SocialRecord &record)
+    {
+        if (record.user == SOCIAL_NO_USER)
+            return;
+        auto &elements = additions[added.externalId(record.user)];
+        if (elements.empty())
+            order.push_back(added.externalId(record.user));
+        elements.push_back(&record);
+    });
+
+    for (int id : order)
+    {
+        const vector<const SocialRecord *> &elements = additions[id];
+        const SocialRecord &element = *elements.front();
+        uint32_t user = find(id);
+        bool existing = user != SOCIAL_NO_USER && patches.firstRecord[user] != SOCIAL_NO_USER;
+
+        uint32_t r;
+        if (existing)
+        {
+            r = patches.firstRecord[user];
+        }
+        else
+        {
+            user = internUser(id);
+            SocialRecord record;
+            record.idOffset = poolText(added.recordId(element));
+            record.idLength = element.idLength;
+            record.nameOffset = poolText(added.recordName(element));
+            record.nameLength = element.nameLength;
+            record.postBegin = record.postEnd = (uint32_t)(index_Posts.size() + patches.posts.size());
+            record.user = user;
+            r = (uint32_t)(index_Records.size() + patches.records.size());
+            patches.records.push_back(record);
+            patches.firstRecord[user] = r;
+            patches.entries++;
+            summary.usersAdded++;
+        }
+
+        SocialRecord &record = patchRecord(r);
+        if (existing && element.nameLength > 0)
+        {
+            record.nameOffset = poolText(added.recordName(element));
+            record.nameLength = element.nameLength;
+        }
+
+        size_t newPosts = 0;
+        for (const SocialRecord *given : elements)
+            newPosts += given->postEnd - given->postBegin;
+        if (newPosts > 0)
+        {
+            PostRange old = recordPosts(record);
+            vector<SocialPost> kept(old.begin(), old.end());
+            uint32_t begin = (uint32_t)(index_Posts.size() + patches.posts.size());
+            patches.posts.insert(patches.posts.end(), kept.begin(), kept.end());
+            patches.entries += kept.size();
+            for (const SocialRecord *given : elements)
+            {
+                for (const SocialPost &post : added.recordPosts(*given))
+                    copyPost(added, post);
+            }
+            record.postBegin = begin;
+            record.postEnd = (uint32_t)(index_Posts.size() + patches.posts.size());
+            summary.postsAdded += newPosts;
+        }
+
+        // Follows that already exist are skipped
+        AdjacencyRange current = sortedFollowers(user);
+        unordered_set<uint32_t> present(current.begin(), current.end());
+        for (uint32_t follower : added.followers(element.user))
+        {
+            uint32_t followerUser = internUser(added.externalId(follower));
+            if (!present.insert(followerUser).second)
+                continue;
+            addFollow(user, followerUser);
+            patchRecord(r).followerCount++;
+            summary.followsAdded++;
+        }
+    }
+
+    // The delta is applied either way; if the lists cannot be laid out, the overlay stays
+    size_t laidOut = follower_Ids.size() + index_Records.size() + index_Posts.size();
+    if (patches.entries * DELTA_COMPACT_DIVISOR > laidOut || patches.copied > laidOut)
+        compact();
+    return true;
+}
+
+// Every record in document order, its posts copied and its user's follows added
+// after its first record, which is what build() reads from the patched document
+bool SocialIndex::layOut(SocialIndex &target) const
+{
+    IndexBuilder builder;
+    vector<char> copied(userCount(), 0);
+    forEachRecord([&](const SocialRecord &old)
+    {
+        SocialRecord record = old;
+        record.idOffset = builder.pool(recordId(old));
+        record.nameOffset = builder.pool(recordName(old));
+        record.postBegin = (uint32_t)builder.posts.size();
+        for (const SocialPost &post : recordPosts(old))
+        {
+            SocialPost copy;
+            copy.bodyOffset = builder.pool(postBody(post));
+            copy.bodyLength = post.bodyLength;
+            copy.topicBegin = (uint32_t)builder.postTopics.size();
+            for (uint32_t topic : postTopics(post))
+                builder.postTopics.push_back(builder.internTopic(topicName(topic)));
+            copy.topicEnd = (uint32_t)builder.postTopics.size();
+            builder.posts.push_back(copy);
+        }
+        record.postEnd = (uint32_t)builder.posts.size();
+
+        if (old.user != SOCIAL_NO_USER)
+        {
+            record.user = builder.internUser(externalId(old.user));
+            if (!copied[old.user])
+            {
+                copied[old.user] = 1;
+                for (uint32_t follower : followers(old.user))
+                    builder.edges.push_back({record.user, externalId(follower)});
+            }
+        }
+        builder.records.push_back(record);
+    });
+
+    if (!builder.finish(target))
+        return false;
+    return coded_Offsets.size() == 0 || target.codeLists();
+}
+
+bool SocialIndex::compact()
+{
+    if (!delta_Overlay)
+        return true;
+
+    SocialIndex laidOut;
+    if (!layOut(laidOut))
+        return false;
+    *this = move(laidOut);
+    return true;
+}
+
+// ==================== Queries ====================
+
+uint32_t SocialIndex::find(int id) const
+{
+    if (delta_Overlay)
+    {
+        auto added = delta_Overlay->userLookup.find(id);
+        if (added != delta_Overlay->userLookup.end())
+            return delta_Overlay->removedUsers.count(added->second) ? SOCIAL_NO_USER : added->second;
+    }
+
+    const int *found = lower_bound(lookup_Ids.begin(), lookup_Ids.end(), id);
+    if (found == lookup_Ids.end() || *found != id)
+        return SOCIAL_NO_USER;
+    uint32_t user = lookup_Users[found - lookup_Ids.begin()];
+    return delta_Overlay && delta_Overlay->removedUsers.count(user) ? SOCIAL_NO_USER : user;
+}
+
+// The patched lists of user, or null if the arrays hold them
+static const PatchedLists *patchedLists(const unique_ptr<DeltaOverlay> &overlay, uint32_t user)
+{
+    if (!overlay || overlay->lists.empty())
+        return nullptr;
+    auto found = overlay->lists.find(user);
+    return found == overlay->lists.end() ? nullptr : &found->second;
+}
+
+static AdjacencyRange rangeOf(const vector<uint32_t> &list)
+{
+    return {list.data(), list.data() + list.size()};
+}
+
+AdjacencyRange SocialIndex::followers(uint32_t user) const
+{
+    if (const PatchedLists *patched = patchedLists(delta_Overlay, user))
+        return rangeOf(patched->followers);
+    const uint32_t *base = follower_Ids.data();
+    return {base + follower_Offsets[user], base + follower_Offsets[user + 1]};
+}
+
+AdjacencyRange SocialIndex::following(uint32_t user) const
+{
+    if (const PatchedLists *patched = patchedLists(delta_Overlay, user))
+        return rangeOf(patched->following);
+    const uint32_t *base = following_Ids.data();
+    return {base + following_Offsets[user], base + following_Offsets[user + 1]};
+}
+
+AdjacencyRange SocialIndex::sortedFollowers(uint32_t user) const
+{
+    if (const PatchedLists *patched = patchedLists(delta_Overlay, user))
+        return rangeOf(patched->sorted);
+    const uint32_t *base = sorted_Followers.data();
+    return {base + sorted_Offsets[user], base + sorted_Offsets[user + 1]};
+}
+
+size_t SocialIndex::adjacencyBytes() const
+{
+    size_t patched = 0;
+    if (delta_Overlay)
+    {
+        for (const auto &entry : delta_Overlay->lists)
+            patched += entry.second.followers.size() + entry.second.following.size() + entry.second.sorted.size();
+    }
+    return (follower_Offsets.size() + follower_Ids.size() + following_Offsets.size() + following_Ids.size() +
+            sorted_Offsets.size() + sorted_Followers.size() + patched) * sizeof(uint32_t);
+}
+
+void SocialIndex::dropPages(const void *first, const void *last) const
+{
+#ifdef _WIN32
+    (void)first;
+    (void)last;
+#else
+    if (!snapshot_Mapping)
+        return;
+    // Only whole pages inside the range, so neighbouring arrays keep theirs
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t begin = ((uintptr_t)first + page - 1) / page * page;
+    uintptr_t end = (uintptr_t)last / page * page;
+    if (begin < end)
+        madvise((void *)begin, end - begin, MADV_DONTNEED);
+#endif
+}
+
+void SocialIndex::releaseAdjacency()
+{
+    for (const IndexArray<uint32_t> *array : {&follower_Offsets, &follower_Ids, &following_Offsets, &following_Ids,
+                                              &sorted_Offsets, &sorted_Followers})
+        dropPages(array->begin(), array->end());
+
+    follower_Offsets = IndexArray<uint32_t>();
+    follower_Ids = IndexArray<uint32_t>();
+    following_Offsets = IndexArray<uint32_t>();
+    following_Ids = IndexArray<uint32_t>();
+    sorted_Offsets = IndexArray<uint32_t>();
+    sorted_Followers = IndexArray<uint32_t>();
+    if (delta_Overlay)
+        delta_Overlay->lists.clear();
+}
+
+bool SocialIndex::codeLists(int threads, bool release)
+{
+    if (!compact())
+        return false;
+
+    // Released lists are read front to back, so the pages of every user coded so
+    // far go back after each round
+    auto listsOf = [&](uint32_t u, vector<uint32_t> &)
+    {
+        return UserLists{followers(u), following(u), sortedFollowers(u)};
+    };
+    auto coded = [&](size_t end)
+    {
+        if (!release)
+            return;
+        dropPages(follower_Ids.begin(), follower_Ids.begin() + follower_Offsets[end]);
+        dropPages(following_Ids.begin(), following_Ids.begin() + following_Offsets[end]);
+        dropPages(sorted_Followers.begin(), sorted_Followers.begin() + sorted_Offsets[end]);
+    };
+
+    CompactLists lists;
+    if (!encodeCompactLists(userCount(), threads, listsOf, coded, lists))
+        return false;
+    coded_Lists.adopt(move(lists.bytes));
+    coded_Blocks.adopt(move(lists.blocks));
+    coded_Offsets.adopt(move(lists.offsets));
+    if (release)
+        releaseAdjacency();
+    return true;
+}
+
+bool SocialIndex::hasCodedLists() const
+{
+    return !delta_Overlay && user_Ids.size() > 0 && coded_Offsets.size() == user_Ids.size();
+}
+
+size_t SocialIndex::codedBytes() const
+{
+    return coded_Lists.size() + coded_Blocks.size() * sizeof(uint64_t) + coded_Offsets.size() * sizeof(uint32_t);
+}
+
+// Text at offset; offsets past the text pool are in the overlay's
+static string_view pooledText(const IndexArray<char> &pool, const unique_ptr<DeltaOverlay> &overlay,
+                              uint64_t offset, uint64_t length)
+{
+    if (overlay && offset >= pool.size())
+        return string_view(overlay->textPool.data() + (offset - pool.size()), length);
+    return string_view(pool.data() + offset, length);
+}
+
+string_view SocialIndex::recordId(const SocialRecord &record) const
+{
+    return pooledText(text_Pool, delta_Overlay, record.idOffset, record.idLength);
+}
+
+string_view SocialIndex::recordName(const SocialRecord &record) const
+{
+    return pooledText(text_Pool, delta_Overlay, record.nameOffset, record.nameLength);
+}
+
+PostRange SocialIndex::recordPosts(const SocialRecord &record) const
+{
+    if (delta_Overlay && record.postBegin >= index_Posts.size() && record.postEnd > record.postBegin)
+    {
+        const SocialPost *base = delta_Overlay->posts.data();
+        return {base + (record.postBegin - index_Posts.size()), base + (record.postEnd - index_Posts.size())};
+    }
+    const SocialPost *base = index_Posts.data();
+    return {base + record.postBegin, base + record.postEnd};
+}
+
+string_view SocialIndex::postBody(const SocialPost &post) const
+{
+    return pooledText(text_Pool, delta_Overlay, post.bodyOffset, post.bodyLength);
+}
+
+size_t SocialIndex::topicCount() const
+{
+    size_t laidOut = topic_Offsets.size() ? topic_Offsets.size() - 1 : 0;
+    return laidOut + (delta_Overlay ? delta_Overlay->topicOffsets.size() - 1 : 0);
+}
+
+string_view SocialIndex::topicName(uint32_t topic) const
+{
+    size_t laidOut = topic_Offsets.size() ? topic_Offsets.size() - 1 : 0;
+    if (topic >= laidOut)
+    {
+        const vector<uint64_t> &offsets = delta_Overlay->topicOffsets;
+        size_t t = topic - laidOut;
+        return string_view(delta_Overlay->topicPool.data() + offsets[t], offsets[t + 1] - offsets[t]);
+    }
+    return string_view(topic_Pool.data() + topic_Offsets[topic], topic_Offsets[topic + 1] - topic_Offsets[topic]);
+}
+
+AdjacencyRange SocialIndex::postTopics(const SocialPost &post) const
+{
+    if (delta_Overlay && post.topicBegin >= post_Topics.size() && post.topicEnd > post.topicBegin)
+    {
+        const uint32_t *base = delta_Overlay->postTopics.data();
+        return {base + (post.topicBegin - post_Topics.size()), base + (post.topicEnd - post_Topics.size())};
+    }
+    const uint32_t *base = post_Topics.data();
+    return {base + post.topicBegin, base + post.topicEnd};
+}
+
+// ==================== Snapshot ====================
+
+const uint32_t SNAPSHOT_ARRAYS = 18;
+const size_t SNAPSHOT_HEADER_SIZE = 16 + 16 * SNAPSHOT_ARRAYS;
+
+template <typename Self, typename Visit>
+void SocialIndex::visitArrays(Self &self, Visit visit)
+{
+    visit(self.index_Records);
+    visit(self.index_Posts);
+    visit(self.post_Topics);
+    visit(self.topic_Pool);
+    visit(self.topic_Offsets);
+    visit(self.text_Pool);
+    visit(self.user_Ids);
+    visit(self.lookup_Ids);
+    visit(self.lookup_Users);
+    visit(self.follower_Offsets);
+    visit(self.follower_Ids);
+    visit(self.following_Offsets);
+    visit(self.following_Ids);
+    visit(self.sorted_Offsets);
+    visit(self.sorted_Followers);
+    visit(self.coded_Lists);
+    visit(self.coded_Blocks);
+    visit(self.coded_Offsets);
+}
+
+bool isSnapshotFile(const string &path)
+{
+    ifstream file(path, ios::binary);
+    char magic[4];
+    return file.read(magic, 4) && memcmp(magic, SNAPSHOT_MAGIC, 4) == 0;
+}
+
+// Arrays are written as they are in memory, so a snapshot records whose byte order they use
+static unsigned char hostByteOrder()
+{
+    const uint16_t probe = 1;
+    return *(const unsigned char *)&probe ? SNAPSHOT_LITTLE_ENDIAN : SNAPSHOT_BIG_ENDIAN;
+}
+
+string SocialIndex::serialize() const
+{
+    if (delta_Overlay)
+    {
+        SocialIndex laidOut;
+        if (!layOut(laidOut))
+            return "";
+        return laidOut.serialize();
+    }
+
+    string out(SNAPSHOT_MAGIC, 4);
+    out += (char)SNAPSHOT_VERSION;
+    out += (char)sizeof(SocialRecord);
+    out += (char)sizeof(SocialPost);
+    out += (char)hostByteOrder();
+    putU32(out, SNAPSHOT_ARRAYS);
+    putU32(out, 0);
+
+    string table;
+    out.resize(SNAPSHOT_HEADER_SIZE, '\0');
+    visitArrays(*this, [&](const auto &array)
+    {
+        out.resize((out.size() + 7) / 8 * 8, '\0');
+        putU64(table, out.size());
+        putU64(table, array.size());
+        out.append((const char *)array.data(), array.size() * sizeof(*array.data()));
+    });
+    out.replace(16, table.size(), table);
+    return out;
+}
+
+// Offsets start at 0 and never go down (the last one was checked against ids),
+// and every id is a dense id; sorted lists must also ascend without repeats
+static bool checkLists(const IndexArray<uint32_t> &offsets, const IndexArray<uint32_t> &ids, size_t users,
+                       bool sorted)
+{
+    if (offsets[0] != 0)
+        return false;
+    for (size_t u = 0; u < users; ++u)
+    {
+        if (offsets[u] > offsets[u + 1])
+            return false;
+        for (uint32_t e = offsets[u]; e < offsets[u + 1]; ++e)
+        {
+            if (ids[e] >= users || (sorted && e > offsets[u] && ids[e] <= ids[e - 1]))
+                return false;
+        }
+    }
+    return true;
+}
+
+// offset and length name a range inside a pool of size bytes
+static bool insidePool(uint64_t offset, uint64_t length, size_t size)
+{
+    return length <= size && offset <= size - length;
+}
+
+bool SocialIndex::checkContents() const
+{
+    // Each array's pages are given back once it is checked, so the check never
+    // holds the whole file and only the pages queries use stay resident
+    auto checked = [&](const auto &array) { dropPages(array.begin(), array.end()); };
+
+    size_t users = user_Ids.size();
+    const pair<const IndexArray<uint32_t> *, const IndexArray<uint32_t> *> lists[] = {
+        {&follower_Offsets, &follower_Ids}, {&following_Offsets, &following_Ids}, {&sorted_Offsets, &sorted_Followers}};
+    for (const auto &[offsets, ids] : lists)
+    {
+        if (!checkLists(*offsets, *ids, users, ids == &sorted_Followers))
+            return false;
+        checked(*offsets);
+        checked(*ids);
+    }
+
+    for (size_t i = 0; i < users; ++i)
+    {
+        if (lookup_Users[i] >= users || (i > 0 && lookup_Ids[i] <= lookup_Ids[i - 1]))
+            return false;
+    }
+    checked(lookup_Users);
+    checked(lookup_Ids);
+
+    size_t topics = topic_Offsets.size() - 1;
+    for (size_t t = 0; t < topics; ++t)
+    {
+        if (topic_Offsets[t] > topic_Offsets[t + 1])
+            return false;
+    }
+    for (uint32_t topic : post_Topics)
+    {
+        if (topic >= topics)
+            return false;
+    }
+    checked(post_Topics);
+
+    for (const SocialRecord &record : index_Records)
+    {
+        if ((record.user != SOCIAL_NO_USER && record.user >= users) || record.postBegin > record.postEnd ||
+            record.postEnd > index_Posts.size() || !insidePool(record.idOffset, record.idLength, text_Pool.size()) ||
+            !insidePool(record.nameOffset, record.nameLength, text_Pool.size()))
+            return false;
+    }
+    for (const SocialPost &post : index_Posts)
+    {
+        if (post.topicBegin > post.topicEnd || post.topicEnd > post_Topics.size() ||
+            !insidePool(post.bodyOffset, post.bodyLength, text_Pool.size()))
+            return false;
+    }
+    checked(index_Records);
+    checked(index_Posts);
+
+    if (coded_Offsets.size() > 0 &&
+        !checkCompactLists(coded_Lists.data(), coded_Lists.size(), coded_Blocks.data(), coded_Offsets.data(), users))
+        return false;
+    checked(coded_Lists);
+    checked(coded_Offsets);
+    return true;
+}
+
+bool SocialIndex::open(const string &path)
+{
+    *this = SocialIndex();
+
+    const unsigned char *bytes;
+    size_t size;
+#ifdef _WIN32
+    auto buffer = make_shared<string>();
+    ifstream file(path, ios::binary);
+    if (!file)
+    {
+        cerr << "Error: Cannot open snapshot " << path << endl;
+        return false;
+    }
+    buffer->assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+    bytes = (const unsigned char *)buffer->data();
+    size = buffer->size();
+    snapshot_Mapping = buffer;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        cerr << "Error: Cannot open snapshot " << path << endl;
+        if (fd >= 0)
+            ::close(fd);
+        return false;
+    }
+    size = info.st_size;
+    void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED)
+    {
+        cerr << "Error: Cannot map snapshot " << path << endl;
+        return false;
+    }
+    bytes = (const unsigned char *)mapped;
+    snapshot_Mapping = shared_ptr<const void>(mapped, [size](const void *p) { munmap((void *)p, size); });
+#endif
+
+    if (size < SNAPSHOT_HEADER_SIZE || memcmp(bytes, SNAPSHOT_MAGIC, 4) != 0 || bytes[4] != SNAPSHOT_VERSION ||
+        bytes[5] != sizeof(SocialRecord) || bytes[6] != sizeof(SocialPost) || getU32(bytes + 8) != SNAPSHOT_ARRAYS)
+    {
+        cerr << "Error: " << path << " is not a snapshot this version can read; write it again with snapshot" << endl;
+        *this = SocialIndex();
+        return false;
+    }
+
+    if (bytes[7] != hostByteOrder())
+    {
+        cerr << "Error: " << path << " was written on a host with "
+             << (bytes[7] == SNAPSHOT_BIG_ENDIAN ? "big-endian" : bytes[7] == SNAPSHOT_LITTLE_ENDIAN ? "little-endian" : "unknown")
+             << " byte order; write it again with snapshot on this host" << endl;
+        *this = SocialIndex();
+        return false;
+    }
+
+    // Point every array into the file, after checking it lies inside it
+    bool inside = true;
+    const unsigned char *entry = bytes + 16;
+    visitArrays(*this, [&](auto &array)
+    {
+        typedef typename decay_t<decltype(array)>::value_type Item;
+        uint64_t offset = getU64(entry);
+        uint64_t count = getU64(entry + 8);
+        entry += 16;
+        if (offset % 8 != 0 || offset > size || count > (size - offset) / sizeof(Item))
+        {
+            inside = false;
+            return;
+        }
+        array.view((const Item *)(bytes + offset), count);
+    });
+
+    size_t users = user_Ids.size();
+    bool consistent = inside && lookup_Ids.size() == users && lookup_Users.size() == users &&
+                      follower_Offsets.size() == users + 1 && following_Offsets.size() == users + 1 &&
+                      sorted_Offsets.size() == users + 1 && topic_Offsets.size() >= 1 &&
+                      follower_Offsets[users] == follower_Ids.size() &&
+                      following_Offsets[users] == following_Ids.size() &&
+                      sorted_Offsets[users] == sorted_Followers.size() &&
+                      topic_Offsets[topic_Offsets.size() - 1] == topic_Pool.size();
+
+    // Coded lists are optional; if present, there is a run for every user
+    size_t blocks = (users + COMPACT_BLOCK_USERS - 1) / COMPACT_BLOCK_USERS;
+    if (consistent && (coded_Offsets.size() > 0 || coded_Blocks.size() > 0 || coded_Lists.size() > 0))
+        consistent = coded_Offsets.size() == users && coded_Blocks.size() == blocks &&
+                     (blocks == 0 || coded_Blocks[blocks - 1] <= coded_Lists.size());
+    if (!consistent || !checkContents())
+    {
+        cerr << "Error: Snapshot " << path << " is truncated or damaged" << endl;
+        *this = SocialIndex();
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,346 @@
+#ifndef SOCIAL_INDEX_H
+#define SOCIAL_INDEX_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace std;
+
+// Dense id of a user that is not in the index
+const uint32_t SOCIAL_NO_USER = 0xFFFFFFFF;
+
+// A run of dense ids inside one of the CSR arrays
+struct AdjacencyRange
+{
+    const uint32_t *first;
+    const uint32_t *last;
+
+    const uint32_t *begin() const { return first; }
+    const uint32_t *end() const { return last; }
+    size_t size() const { return last - first; }
+    bool empty() const { return first == last; }
+};
+
+// One <user> element, in document order. A user id that appears in several
+// elements has one record per element but a single dense id.
+// Records and posts are written to snapshots as they are, so their fields are
+// laid out without padding.
+struct SocialRecord
+{
+    uint64_t idOffset = 0, idLength = 0;      // raw <id> text in the text pool
+    uint64_t nameOffset = 0, nameLength = 0;  // raw <name> text in the text pool
+    uint32_t user = SOCIAL_NO_USER;  // dense id, SOCIAL_NO_USER if <id> is missing or not a number
+    uint32_t postBegin = 0, postEnd = 0;    // range in posts()
+    uint32_t followerCount = 0;             // <follower> elements in this record
+};
+
+struct SocialPost
+{
+    uint64_t bodyOffset = 0, bodyLength = 0;  // <body> text in the text pool
+    uint32_t topicBegin = 0, topicEnd = 0;    // range in postTopics()
+};
+
+// The posts of one record
+struct PostRange
+{
+    const SocialPost *first;
+    const SocialPost *last;
+
+    const SocialPost *begin() const { return first; }
+    const SocialPost *end() const { return last; }
+    size_t size() const { return last - first; }
+};
+
+// One <user> element as seen by scanUserRecords; the views point into the document
+struct UserSummary
+{
+    string_view id;
+    string_view name;
+    uint32_t postCount = 0;
+    uint32_t followerCount = 0;
+};
+
+// Visits every <user> element in document order without building an index or
+// allocating; enough for rankings by post or follower count
+void scanUserRecords(const string &xml, const function<void(const UserSummary &)> &visit);
+
+// Read-only array of a SocialIndex: owns its elements after build(), or points
+// into the mapped file after open(). Moving keeps the elements where they are.
+template <typename T>
+class IndexArray {
+private:
+    vector<T> owned_Items;
+    const T *first_Item = nullptr;
+    size_t item_Count = 0;
+
+public:
+    typedef T value_type;
+
+    IndexArray() = default;
+    IndexArray(const IndexArray &) = delete;
+    IndexArray &operator=(const IndexArray &) = delete;
+    IndexArray(IndexArray &&) = default;
+    IndexArray &operator=(IndexArray &&) = default;
+
+    void adopt(vector<T> &&items)
+    {
+        owned_Items = move(items);
+        first_Item = owned_Items.data();
+        item_Count = owned_Items.size();
+    }
+
+    void view(const T *items, size_t count)
+    {
+        owned_Items.clear();
+        first_Item = items;
+        item_Count = count;
+    }
+
+    const T *data() const { return first_Item; }
+    size_t size() const { return item_Count; }
+    const T &operator[](size_t i) const { return first_Item[i]; }
+    const T *begin() const { return first_Item; }
+    const T *end() const { return first_Item + item_Count; }
+};
+
+// Graph snapshot: a SocialIndex written by serialize() and mapped by open().
+// Layout (header and table little-endian; the arrays in host byte order and native
+// struct layout, so they are read by the same build on the same kind of host):
+//   "XSNP", u8 version, u8 sizeof(SocialRecord), u8 sizeof(SocialPost),
+//   u8 byte order of the arrays, u32 array count, u32 reserved, then per array
+//   u64 file offset and u64 element count, then the arrays themselves, each
+//   starting on an 8-byte boundary. The last three arrays are the varint-coded
+//   lists, empty unless they were coded before writing.
+const char SNAPSHOT_MAGIC[4] = {'X', 'S', 'N', 'P'};
+const unsigned char SNAPSHOT_VERSION = 1;
+const unsigned char SNAPSHOT_LITTLE_ENDIAN = 1;
+const unsigned char SNAPSHOT_BIG_ENDIAN = 2;
+
+bool isSnapshotFile(const string &path);
+
+// What SocialIndex::applyDelta changed
+struct DeltaSummary
+{
+    size_t usersAdded = 0, usersRemoved = 0;
+    size_t followsAdded = 0, followsRemoved = 0;
+    size_t postsAdded = 0, postsRemoved = 0;
+};
+
+// The three lists of a user changed by a delta, in full
+struct PatchedLists
+{
+    vector<uint32_t> followers, following, sorted;
+};
+
+// What applyDelta changed since the arrays were laid out. Users, records, posts,
+// topics and text added by deltas are numbered on from the end of the arrays;
+// a record or user list a delta changed is kept here whole and replaces the one
+// in the arrays.
+struct DeltaOverlay
+{
+    vector<int> userIds;
+    unordered_map<int, uint32_t> userLookup;
+    unordered_set<uint32_t> removedUsers;  // no records and no follows until laid out again
+    unordered_map<uint32_t, PatchedLists> lists;
+
+    vector<SocialRecord> records;
+    unordered_map<uint32_t, SocialRecord> patchedRecords;
+    unordered_set<uint32_t> removedRecords;
+    vector<uint32_t> firstRecord;  // per user, SOCIAL_NO_USER if it has none
+    unordered_map<uint32_t, vector<uint32_t>> laterRecords;  // users with several records
+
+    vector<SocialPost> posts;
+    vector<uint32_t> postTopics;
+    vector<char> topicPool;
+    vector<uint64_t> topicOffsets = vector<uint64_t>(1, 0);
+    unordered_map<string, uint32_t> topicLookup;
+    vector<char> textPool;
+
+    size_t entries = 0;  // follows, records and posts changed, against DELTA_COMPACT_DIVISOR
+    size_t copied = 0;   // list entries copied from the arrays
+};
+
+// The overlay is laid out into new arrays once the follows, records and posts
+// changed pass this fraction of the entries in the arrays, or the lists copied
+// into it hold as many entries as the arrays
+const size_t DELTA_COMPACT_DIVISOR = 4;
+
+// Everything the network analytics read, built from one scan of the document.
+// Users get dense ids 0..userCount()-1: users with a <user> element first, in
+// document order, then ids that only appear as followers. Follower and following
+// lists are stored in CSR form (one offsets array, one flat array of dense ids);
+// follower lists keep document order, following lists are in dense id order.
+// A second copy of every follower list is sorted and free of repeats, for the
+// intersection engine (intersection.h). Ids are looked up by binary search in a
+// sorted copy, so a mapped snapshot needs no hash table rebuilt.
+class SocialIndex {
+private:
+    IndexArray<SocialRecord> index_Records;
+    IndexArray<SocialPost> index_Posts;
+    IndexArray<uint32_t> post_Topics;
+    IndexArray<char> topic_Pool;
+    IndexArray<uint64_t> topic_Offsets;  // topic t is topic_Pool[topic_Offsets[t], topic_Offsets[t + 1])
+    IndexArray<char> text_Pool;
+
+    IndexArray<int> user_Ids;
+    IndexArray<int> lookup_Ids;  // user ids, sorted
+    IndexArray<uint32_t> lookup_Users;  // dense id of each of lookup_Ids
+
+    IndexArray<uint32_t> follower_Offsets, follower_Ids;
+    IndexArray<uint32_t> following_Offsets, following_Ids;
+    IndexArray<uint32_t> sorted_Offsets, sorted_Followers;
+
+    // The same lists varint-coded (compact_graph.h), empty unless codeLists() or
+    // buildCoded() made them or the snapshot holds them
+    IndexArray<uint8_t> coded_Lists;
+    IndexArray<uint64_t> coded_Blocks;
+    IndexArray<uint32_t> coded_Offsets;
+
+    shared_ptr<const void> snapshot_Mapping;  // keeps a mapped snapshot alive
+    unique_ptr<DeltaOverlay> delta_Overlay;    // null until applyDelta
+
+    friend struct IndexBuilder;
+
+    // Calls visit(array) for every array, in snapshot order
+    template <typename Self, typename Visit>
+    static void visitArrays(Self &self, Visit visit);
+
+    // Overlay helpers for applyDelta
+    DeltaOverlay &overlay();
+    PatchedLists &patchLists(uint32_t user);
+    SocialRecord &patchRecord(uint32_t record);
+    vector<uint32_t> recordsOf(uint32_t user) const;
+    uint32_t internUser(int id);
+    uint64_t poolText(string_view text);
+    uint32_t internTopic(string_view topic);
+    void removeFollow(uint32_t user, uint32_t follower, size_t &removed);
+    void addFollow(uint32_t user, uint32_t follower);
+
+    // Lays the current index, overlay included, out as fresh arrays in target;
+    // false if its lists no longer fit the index
+    bool layOut(SocialIndex &target) const;
+
+    // Checks every offset, id, range and coded list of a mapped snapshot, so a
+    // damaged file is refused instead of read out of bounds
+    bool checkContents() const;
+
+    // Gives back the pages of a mapped array between first and last; owned arrays
+    // are left as they are
+    void dropPages(const void *first, const void *last) const;
+
+public:
+    // Reads <user> elements with <id>, <name>, <posts> and <followers>; follower ids
+    // may be written as <follower><id>X</id></follower> or <follower>X</follower>.
+    // False, after an error on cerr, if there are more follows than the 32-bit list
+    // offsets can hold.
+    bool build(const string &xml);
+
+    // Like build(), but the follower and following lists are only kept varint-coded,
+    // coded on up to threads workers without laying out the plain arrays first;
+    // followers(), following() and sortedFollowers() must not be called. False if
+    // the lists do not fit the offsets of the coded lists.
+    bool buildCoded(const string &xml, int threads = 1);
+
+    // Snapshot bytes (see SNAPSHOT_MAGIC), laid out from the overlay if there is one;
+    // write them with writeBinaryToFile. Empty if the overlay cannot be laid out.
+    string serialize() const;
+
+    // Maps a snapshot file (reads it whole where mmap is not available); the arrays
+    // are used in place after one pass that checks their contents
+    bool open(const string &path);
+
+    // Applies a delta document to a built or mapped index:
+    //   <delta>
+    //     <add> <user> elements: new users, or followers and posts (and a new name)
+    //           for existing ones; follows that already exist are skipped </add>
+    //     <remove> <user> elements: one with only an <id> removes the user and every
+    //              follow of it; otherwise its listed followers and its posts with
+    //              the same <body> are removed </remove>
+    //   </delta>
+    // Removals are applied first. Only the lists, records and posts the delta
+    // touches are copied, into an overlay that every accessor consults; a removed
+    // user keeps its dense id, with no record and no follows. The overlay is laid
+    // out into new arrays by compact(), by serialize() and once it grows past
+    // DELTA_COMPACT_DIVISOR. Laid out, the index matches a
+    // build() of the patched document, post and follower counts included.
+    bool applyDelta(const string &delta, DeltaSummary &summary);
+    // False, keeping the overlay, if the patched lists do not fit the index
+    bool compact();
+
+    // Dense ids of removed users still count until the overlay is laid out
+    size_t userCount() const { return user_Ids.size() + (delta_Overlay ? delta_Overlay->userIds.size() : 0); }
+    int externalId(uint32_t user) const
+    {
+        return user < user_Ids.size() ? user_Ids[user] : delta_Overlay->userIds[user - user_Ids.size()];
+    }
+    uint32_t find(int id) const;
+
+    AdjacencyRange followers(uint32_t user) const;
+    AdjacencyRange following(uint32_t user) const;
+    AdjacencyRange sortedFollowers(uint32_t user) const;
+
+    // Bytes held by the follower and following lists and their offsets
+    size_t adjacencyBytes() const;
+
+    // Frees those lists once a CompactGraph (compact_graph.h) holds them, giving the
+    // pages of a mapped snapshot back; followers(), following() and sortedFollowers()
+    // must not be called afterwards
+    void releaseAdjacency();
+
+    // Codes the lists on up to threads workers, so serialize() writes them too and a
+    // CompactGraph reads them in place. With release, the plain lists are released
+    // round by round as they are coded. False if they do not fit the offsets.
+    bool codeLists(int threads = 1, bool release = false);
+
+    // Coded lists, their block offsets and their user offsets (compact_graph.h);
+    // an overlay from applyDelta leaves them out of date until it is laid out
+    bool hasCodedLists() const;
+    const uint8_t *codedLists() const { return coded_Lists.data(); }
+    const uint64_t *codedBlocks() const { return coded_Blocks.data(); }
+    const uint32_t *codedOffsets() const { return coded_Offsets.data(); }
+    size_t codedBytes() const;
+
+    // Calls visit(record) for every <user> element, in document order
+    template <typename Visit>
+    void forEachRecord(Visit visit) const;
+    string_view recordId(const SocialRecord &record) const;
+    string_view recordName(const SocialRecord &record) const;
+
+    PostRange recordPosts(const SocialRecord &record) const;
+    string_view postBody(const SocialPost &post) const;
+    AdjacencyRange postTopics(const SocialPost &post) const;
+    size_t topicCount() const;
+    string_view topicName(uint32_t topic) const;
+};
+
+template <typename Visit>
+void SocialIndex::forEachRecord(Visit visit) const
+{
+    if (!delta_Overlay)
+    {
+        for (const SocialRecord &record : index_Records)
+            visit(record);
+        return;
+    }
+
+    const DeltaOverlay &overlay = *delta_Overlay;
+    size_t total = index_Records.size() + overlay.records.size();
+    for (uint32_t r = 0; r < total; ++r)
+    {
+        if (overlay.removedRecords.count(r))
+            continue;
+        auto patched = overlay.patchedRecords.find(r);
+        if (patched != overlay.patchedRecords.end())
+            visit(patched->second);
+        else
+            visit(r < index_Records.size() ? index_Records[r] : overlay.records[r - index_Records.size()]);
+    }
+}
+
+#endif
@@ -0,0 +1,140 @@
+#include "traversal.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+using namespace std;
+
+bool parsePathDirection(const string &name, PathDirection &direction)
+{
+    if (name == "following")
+        direction = PATH_FOLLOWING;
+    else if (name == "followers")
+        direction = PATH_FOLLOWERS;
+    else if (name == "any")
+        direction = PATH_ANY;
+    else
+        return false;
+    return true;
+}
+
+// ==================== Search ====================
+
+// One end of the search: a bitset of the users reached, the parent (towards this
+// side's start) and depth of each, and the users of the last level
+struct SearchSide
+{
+    vector<uint64_t> seen;
+    unordered_map<uint32_t, uint32_t> parent, depth;
+    vector<uint32_t> frontier;
+    bool forward;  // walks the chain's edges forwards (from the source)
+
+    SearchSide(size_t users, uint32_t start, bool forward)
+        : seen((users + 63) / 64, 0), frontier{start}, forward(forward)
+    {
+        add(start, start, 0);
+    }
+
+    bool contains(uint32_t u) const { return seen[u >> 6] >> (u & 63) & 1; }
+
+    void add(uint32_t u, uint32_t from, uint32_t d)
+    {
+        seen[u >> 6] |= 1ULL << (u & 63);
+        parent.emplace(u, from);
+        depth.emplace(u, d);
+    }
+};
+
+// Calls visit(v) for every v one step along the chain from u (or one step back)
+template <typename Visit>
+static void forEachNeighbour(const SocialIndex &index, uint32_t u, PathDirection direction, bool forward, Visit visit)
+{
+    // "u follows v" edges are found in following(u) forwards and followers(u) backwards
+    bool useFollowing = direction == PATH_ANY || (direction == PATH_FOLLOWING) == forward;
+    bool useFollowers = direction == PATH_ANY || (direction == PATH_FOLLOWING) != forward;
+    if (useFollowing)
+    {
+        for (uint32_t v : index.following(u))
+            visit(v);
+    }
+    if (useFollowers)
+    {
+        for (uint32_t v : index.followers(u))
+            visit(v);
+    }
+}
+
+static size_t frontierDegree(const SocialIndex &index, const SearchSide &side, PathDirection direction)
+{
+    bool useFollowing = direction == PATH_ANY || (direction == PATH_FOLLOWING) == side.forward;
+    bool useFollowers = direction == PATH_ANY || (direction == PATH_FOLLOWING) != side.forward;
+    size_t degree = 0;
+    for (uint32_t u : side.frontier)
+        degree += (useFollowing ? index.following(u).size() : 0) + (useFollowers ? index.followers(u).size() : 0);
+    return degree;
+}
+
+// Follows parents from u back to the start of the side, u included
+static void walkToStart(const SearchSide &side, uint32_t u, vector<uint32_t> &chain)
+{
+    while (true)
+    {
+        chain.push_back(u);
+        uint32_t from = side.parent.at(u);
+        if (from == u)
+            return;
+        u = from;
+    }
+}
+
+bool shortestPath(const SocialIndex &index, uint32_t source, uint32_t target, PathDirection direction,
+                  vector<uint32_t> &path, size_t &visited)
+{
+    path.clear();
+    SearchSide front(index.userCount(), source, true);
+    SearchSide back(index.userCount(), target, false);
+
+    // Levels are grown whole, so the first level that reaches the other side holds
+    // a shortest chain: the meeting point closest to the other side's start
+    uint32_t meeting = source == target ? source : SOCIAL_NO_USER;
+
+    while (meeting == SOCIAL_NO_USER && !front.frontier.empty() && !back.frontier.empty())
+    {
+        // Grow the side that has less work
+        bool growFront = frontierDegree(index, front, direction) <= frontierDegree(index, back, direction);
+        SearchSide &side = growFront ? front : back;
+        SearchSide &other = growFront ? back : front;
+
+        uint32_t bestRemaining = UINT32_MAX;
+        vector<uint32_t> next;
+        for (uint32_t u : side.frontier)
+        {
+            uint32_t d = side.depth.at(u) + 1;
+            forEachNeighbour(index, u, direction, side.forward, [&](uint32_t v)
+            {
+                if (side.contains(v))
+                    return;
+                side.add(v, u, d);
+                next.push_back(v);
+                if (other.contains(v) && other.depth.at(v) < bestRemaining)
+                {
+                    bestRemaining = other.depth.at(v);
+                    meeting = v;
+                }
+            });
+        }
+        side.frontier.swap(next);
+    }
+
+    visited = front.parent.size() + back.parent.size();
+    if (meeting == SOCIAL_NO_USER)
+        return false;
+
+    // source ... meeting, then meeting's successors down to target
+    walkToStart(front, meeting, path);
+    reverse(path.begin(), path.end());
+    vector<uint32_t> rest;
+    walkToStart(back, meeting, rest);
+    path.insert(path.end(), rest.begin() + 1, rest.end());
+    return true;
+}
@@ -0,0 +1,34 @@
+#ifndef TRAVERSAL_H
+#define TRAVERSAL_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "social_index.h"
+
+using namespace std;
+
+// Which edges a chain from one user to another may use:
+//   following : each user follows the next one
+//   followers : each user is followed by the next one
+//   any       : either, i.e. the undirected graph
+enum PathDirection
+{
+    PATH_FOLLOWING,
+    PATH_FOLLOWERS,
+    PATH_ANY
+};
+
+// Parses "following", "followers" or "any"; false for anything else
+bool parsePathDirection(const string &name, PathDirection &direction);
+
+// Shortest chain from source to target by bidirectional BFS: the side with the
+// smaller frontier grows by one level at a time, visited users are kept in one
+// bitset per side and parents only for the users reached. path receives source,
+// ..., target; false (and an empty path) if target cannot be reached.
+// visited receives the number of users the search reached.
+bool shortestPath(const SocialIndex &index, uint32_t source, uint32_t target, PathDirection direction,
+                  vector<uint32_t> &path, size_t &visited);
+
+#endif
@@ -0,0 +1,162 @@
+#include "triangles.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+using namespace std;
+
+// ==================== Undirected Graph ====================
+
+// CSR lists built in two passes: sizes first, then the lists in place
+struct UndirectedLists
+{
+    vector<uint32_t> offsets, ids;
+
+    const uint32_t *begin(uint32_t u) const { return ids.data() + offsets[u]; }
+    const uint32_t *end(uint32_t u) const { return ids.data() + offsets[u + 1]; }
+    uint32_t size(uint32_t u) const { return offsets[u + 1] - offsets[u]; }
+};
+
+// Writes the neighbours of u that keep(v) accepts, sorted and without repeats or
+// u itself, to out (if not null); returns how many there are
+template <typename Keep>
+static uint32_t mergeNeighbours(const SocialIndex &index, uint32_t u, Keep keep, uint32_t *out)
+{
+    // sortedFollowers is repeat-free; following is sorted but may repeat
+    AdjacencyRange a = index.sortedFollowers(u);
+    AdjacencyRange b = index.following(u);
+    const uint32_t *p = a.begin(), *q = b.begin();
+    uint32_t count = 0, last = SOCIAL_NO_USER;
+    while (p != a.end() || q != b.end())
+    {
+        uint32_t v;
+        if (q == b.end() || (p != a.end() && *p <= *q))
+            v = *p++;
+        else
+            v = *q++;
+        if (v == last || v == u)
+            continue;
+        last = v;
+        if (!keep(v))
+            continue;
+        if (out)
+            out[count] = v;
+        count++;
+    }
+    return count;
+}
+
+template <typename Keep>
+static void buildLists(const SocialIndex &index, int threads, Keep keep, UndirectedLists &lists)
+{
+    size_t users = index.userCount();
+    lists.offsets.assign(users + 1, 0);
+    parallelFor(users, threads, [&](size_t begin, size_t end, int)
+    {
+        for (size_t u = begin; u < end; ++u)
+        {
+            auto keepFromU = [&](uint32_t v) { return keep((uint32_t)u, v); };
+            lists.offsets[u + 1] = mergeNeighbours(index, (uint32_t)u, keepFromU, nullptr);
+        }
+    });
+    for (size_t u = 0; u < users; ++u)
+        lists.offsets[u + 1] += lists.offsets[u];
+
+    lists.ids.resize(lists.offsets[users]);
+    parallelFor(users, threads, [&](size_t begin, size_t end, int)
+    {
+        for (size_t u = begin; u < end; ++u)
+        {
+            auto keepFromU = [&](uint32_t v) { return keep((uint32_t)u, v); };
+            mergeNeighbours(index, (uint32_t)u, keepFromU, lists.ids.data() + lists.offsets[u]);
+        }
+    });
+}
+
+// ==================== Counting ====================
+
+TriangleCounts countTriangles(const SocialIndex &index, int threads)
+{
+    size_t users = index.userCount();
+    TriangleCounts counts;
+
+    // Degrees in the undirected graph
+    counts.degree.resize(users);
+    parallelFor(users, threads, [&](size_t begin, size_t end, int)
+    {
+        for (size_t u = begin; u < end; ++u)
+            counts.degree[u] = mergeNeighbours(index, (uint32_t)u, [](uint32_t) { return true; }, nullptr);
+    });
+
+    // Out-neighbours: the neighbours that rank higher
+    const vector<uint32_t> &degree = counts.degree;
+    UndirectedLists out;
+    buildLists(index, threads, [&](uint32_t u, uint32_t v)
+    {
+        return degree[u] < degree[v] || (degree[u] == degree[v] && u < v);
+    }, out);
+
+    unique_ptr<atomic<uint64_t>[]> perUser(new atomic<uint64_t>[users]);
+    for (size_t u = 0; u < users; ++u)
+        perUser[u].store(0, memory_order_relaxed);
+
+    int workers = resolveThreadCount(threads);
+    vector<uint64_t> workerTotals(workers, 0);
+    parallelFor(users, workers, [&](size_t begin, size_t end, int worker)
+    {
+        vector<uint64_t> marked((users + 63) / 64, 0);
+        uint64_t total = 0;
+        for (size_t u = begin; u < end; ++u)
+        {
+            for (const uint32_t *v = out.begin(u); v != out.end(u); ++v)
+                marked[*v >> 6] |= 1ULL << (*v & 63);
+
+            uint64_t found = 0;
+            for (const uint32_t *v = out.begin(u); v != out.end(u); ++v)
+            {
+                for (const uint32_t *w = out.begin(*v); w != out.end(*v); ++w)
+                {
+                    if (marked[*w >> 6] >> (*w & 63) & 1)
+                    {
+                        found++;
+                        perUser[*v].fetch_add(1, memory_order_relaxed);
+                        perUser[*w].fetch_add(1, memory_order_relaxed);
+                    }
+                }
+            }
+            perUser[u].fetch_add(found, memory_order_relaxed);
+            total += found;
+
+            for (const uint32_t *v = out.begin(u); v != out.end(u); ++v)
+                marked[*v >> 6] = 0;
+        }
+        workerTotals[worker] = total;
+    });
+
+    for (uint64_t t : workerTotals)
+        counts.total += t;
+    counts.perUser.resize(users);
+    for (size_t u = 0; u < users; ++u)
+        counts.perUser[u] = perUser[u].load(memory_order_relaxed);
+    return counts;
+}
+
+// ==================== Clustering ====================
+
+double localClustering(const TriangleCounts &counts, uint32_t user)
+{
+    uint64_t d = counts.degree[user];
+    if (d < 2)
+        return 0;
+    return 2.0 * counts.perUser[user] / (d * (d - 1));
+}
+
+double globalClustering(const TriangleCounts &counts)
+{
+    uint64_t triples = 0;
+    for (uint64_t d : counts.degree)
+        triples += d * (d - 1) / 2;
+    return triples == 0 ? 0 : 3.0 * counts.total / triples;
+}
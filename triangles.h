@@ -0,0 +1,32 @@
+#ifndef TRIANGLES_H
+#define TRIANGLES_H
+
+#include <vector>
+#include <cstdint>
+
+#include "social_index.h"
+
+using namespace std;
+
+// Triangles of the undirected follow graph: two users are neighbours if either
+// follows the other; repeated follows and self-follows are ignored
+struct TriangleCounts
+{
+    uint64_t total = 0;
+    vector<uint64_t> perUser;  // triangles each user is part of, by dense id
+    vector<uint32_t> degree;   // distinct neighbours of each user
+};
+
+// Every edge is oriented from the lower-degree end to the higher one (ties by id),
+// so each triangle is found once and no user has more than about sqrt(2 * edges)
+// out-neighbours. For each user its out-neighbours are marked in a per-thread
+// bitset and the out-lists of those neighbours are tested against it.
+TriangleCounts countTriangles(const SocialIndex &index, int threads);
+
+// Triangles through the user over the pairs of its neighbours; 0 below two neighbours
+double localClustering(const TriangleCounts &counts, uint32_t user);
+
+// 3 * triangles / connected triples over the whole graph
+double globalClustering(const TriangleCounts &counts);
+
+#endif
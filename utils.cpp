@@ -1,3 +1,13 @@
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 #include "utils.h"
 #include <fstream>
 #include <sstream>
@@ -90,3 +100,104 @@ bool writeBinaryToFile(const string& outputPath, const string& content) {
     file.close();
     return true;
 }
+
+// ==================== Memory-mapped output ====================
+
+MappedOutputFile::~MappedOutputFile() {
+    close();
+}
+
+bool MappedOutputFile::open(const string& outputPath, size_t size) {
+    close();
+    mapped_Size = size;
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(outputPath.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr,
+                              CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        cerr << "Error: Could not open output file: " << outputPath << endl;
+        return false;
+    }
+    file_Handle = file;
+
+    // A zero-length file cannot be mapped, it only needs to exist
+    if (size == 0)
+        return true;
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE,
+                                        (DWORD)((unsigned long long)size >> 32), (DWORD)(size & 0xFFFFFFFFu), nullptr);
+    if (!mapping) {
+        cerr << "Error: Could not map output file: " << outputPath << endl;
+        close();
+        return false;
+    }
+    mapping_Handle = mapping;
+
+    mapped_Data = (char*)MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, size);
+    if (!mapped_Data) {
+        cerr << "Error: Could not map output file: " << outputPath << endl;
+        close();
+        return false;
+    }
+#else
+    file_Descriptor = ::open(outputPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (file_Descriptor < 0) {
+        cerr << "Error: Could not open output file: " << outputPath << endl;
+        return false;
+    }
+
+    if (size == 0)
+        return true;
+
+    if (ftruncate(file_Descriptor, (off_t)size) != 0) {
+        cerr << "Error: Could not resize output file: " << outputPath << endl;
+        close();
+        return false;
+    }
+
+    void* mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file_Descriptor, 0);
+    if (mapped == MAP_FAILED) {
+        cerr << "Error: Could not map output file: " << outputPath << endl;
+        close();
+        return false;
+    }
+    mapped_Data = (char*)mapped;
+#endif
+
+    return true;
+}
+
+char* MappedOutputFile::data() {
+    return mapped_Data;
+}
+
+size_t MappedOutputFile::size() const {
+    return mapped_Size;
+}
+
+bool MappedOutputFile::close() {
+    bool ok = true;
+
+#ifdef _WIN32
+    if (mapped_Data) {
+        ok = FlushViewOfFile(mapped_Data, 0) && ok;
+        ok = UnmapViewOfFile(mapped_Data) && ok;
+    }
+    if (mapping_Handle)
+        CloseHandle((HANDLE)mapping_Handle);
+    if (file_Handle)
+        CloseHandle((HANDLE)file_Handle);
+    mapping_Handle = nullptr;
+    file_Handle = nullptr;
+#else
+    if (mapped_Data)
+        ok = munmap(mapped_Data, mapped_Size) == 0 && ok;
+    if (file_Descriptor >= 0)
+        ok = ::close(file_Descriptor) == 0 && ok;
+    file_Descriptor = -1;
+#endif
+
+    mapped_Data = nullptr;
+    mapped_Size = 0;
+    return ok;
+}
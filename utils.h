@@ -2,6 +2,7 @@
 #define UTILS_H
 
 #include <string>
+#include <cstddef>
 using namespace std;
 
 // File reading functions
@@ -12,4 +13,29 @@ bool extract_binary_content(const string& path, string& content);
 bool writeToFile(const string& outputPath, const string& content);
 bool writeBinaryToFile(const string& outputPath, const string& content);
 
+// Output file of a known size, memory-mapped so several threads can fill
+// disjoint parts of it directly
+class MappedOutputFile {
+private:
+    char* mapped_Data = nullptr;
+    size_t mapped_Size = 0;
+#ifdef _WIN32
+    void* file_Handle = nullptr;
+    void* mapping_Handle = nullptr;
+#else
+    int file_Descriptor = -1;
+#endif
+
+public:
+    MappedOutputFile() = default;
+    MappedOutputFile(const MappedOutputFile&) = delete;
+    MappedOutputFile& operator=(const MappedOutputFile&) = delete;
+    ~MappedOutputFile();
+
+    bool open(const string& outputPath, size_t size);
+    char* data();
+    size_t size() const;
+    bool close();
+};
+
 #endif
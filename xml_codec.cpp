@@ -0,0 +1,448 @@
+#include "xml_codec.h"
+#include "compression.h"
+#include "parallel.h"
+
+#include <map>
+#include <unordered_map>
+
+using namespace std;
+
+// ==================== Containers ====================
+
+// Container of the text inside the innermost open element
+static string textContainerName(const vector<string> &openElements)
+{
+    if (openElements.empty())
+        return XML_ROOT_CONTAINER;
+    if (openElements.size() == 1)
+        return openElements.back();
+    return openElements[openElements.size() - 2] + "/" + openElements.back();
+}
+
+// Delta-codes a container when every string in it is a plain decimal integer
+static bool encodeNumbers(const string &raw, string &varints)
+{
+    varints.clear();
+    int64_t previous = 0;
+    for (size_t start = 0; start < raw.size();)
+    {
+        size_t terminator = raw.find('\0', start);
+        size_t digits = start + (raw[start] == '-');
+        size_t length = terminator - digits;
+
+        // Only canonical forms, so that printing the value gives back the same text
+        if (length == 0 || length > 18 || (raw[digits] == '0' && (length > 1 || digits > start)))
+            return false;
+
+        int64_t value = 0;
+        for (size_t k = digits; k < terminator; ++k)
+        {
+            if (!isdigit((unsigned char)raw[k]))
+                return false;
+            value = value * 10 + (raw[k] - '0');
+        }
+        if (digits > start)
+            value = -value;
+
+        int64_t delta = value - previous;
+        putVarint(varints, ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63));
+        previous = value;
+        start = terminator + 1;
+    }
+    return true;
+}
+
+static bool decodeNumbers(const string &varints, string &raw)
+{
+    const unsigned char *p = (const unsigned char *)varints.data();
+    const unsigned char *end = p + varints.size();
+    int64_t previous = 0;
+    raw.clear();
+    while (p < end)
+    {
+        uint64_t zigzag;
+        if (!getVarint(p, end, zigzag))
+            return false;
+        previous += (int64_t)((zigzag >> 1) ^ (~(zigzag & 1) + 1));
+        raw += to_string(previous);
+        raw += '\0';
+    }
+    return true;
+}
+
+// Stores a container with one method chosen from cheap statistics: numbers are
+// delta-coded, small text gets byte BPE and large text wide BPE. Raw is kept when
+// coding does not make the container smaller.
+static void encodeContainer(XmlContainer &container, const string &raw)
+{
+    container.rawSize = raw.size();
+    container.method = CONTAINER_RAW;
+    container.payload = raw;
+
+    if (raw.size() < 2)
+        return;
+
+    string varints;
+    if (encodeNumbers(raw, varints))
+    {
+        unsigned char method = CONTAINER_DELTA;
+        if (varints.size() >= XML_WIDE_CONTAINER)
+        {
+            string coded = encodeBPEStream(varints);
+            if (coded.size() < varints.size())
+            {
+                method = CONTAINER_DELTA_BPE;
+                varints = move(coded);
+            }
+        }
+        if (varints.size() < raw.size())
+        {
+            container.method = method;
+            container.payload = move(varints);
+        }
+        return;
+    }
+
+    bool wide = raw.size() >= XML_WIDE_CONTAINER || needsWideSymbols(raw);
+    string coded = encodeBPEStream(raw, wide);
+    if (coded.size() < raw.size())
+    {
+        container.method = CONTAINER_BPE;
+        container.payload = move(coded);
+    }
+}
+
+bool decodeContainer(const XmlContainer &container, string &raw)
+{
+    if (container.method == CONTAINER_RAW)
+        raw = container.payload;
+    else if (container.method == CONTAINER_BPE)
+    {
+        if (!decodeBPEStream(container.payload, raw))
+            return false;
+    }
+    else if (container.method == CONTAINER_DELTA || container.method == CONTAINER_DELTA_BPE)
+    {
+        string varints;
+        if (container.method == CONTAINER_DELTA_BPE && !decodeBPEStream(container.payload, varints))
+            return false;
+        if (!decodeNumbers(container.method == CONTAINER_DELTA ? container.payload : varints, raw))
+        {
+            cerr << "Error: Corrupt numbers in container " << container.name << endl;
+            return false;
+        }
+    }
+    else
+    {
+        cerr << "Error: Unknown method " << (int)container.method << " for container " << container.name << endl;
+        return false;
+    }
+
+    if (raw.size() != container.rawSize)
+    {
+        cerr << "Error: Container " << container.name << " has the wrong size" << endl;
+        return false;
+    }
+    return true;
+}
+
+// ==================== Encoding ====================
+
+string compressStructural(const string &xml, int threads)
+{
+    // NUL separates the strings inside a container, so it cannot appear in the text
+    if (xml.find('\0') != string::npos)
+        return "";
+
+    string structure;
+    string tagTable;
+    unordered_map<string, uint64_t> tagIds;
+    map<string, string> texts; // ordered so the same input gives the same file
+    vector<string> openElements;
+
+    auto tagId = [&](const string &content)
+    {
+        auto found = tagIds.find(content);
+        if (found != tagIds.end())
+            return found->second;
+
+        uint64_t id = tagIds.size();
+        tagIds[content] = id;
+        tagTable += content;
+        tagTable += '\0';
+        return id;
+    };
+
+    size_t i = 0, n = xml.size();
+    while (i < n)
+    {
+        size_t gt = xml[i] == '<' ? xml.find('>', i) : string::npos;
+        if (gt != string::npos)
+        {
+            string content = xml.substr(i + 1, gt - i - 1);
+            i = gt + 1;
+
+            // A closing tag is implied by the element stack when it matches exactly
+            if (!content.empty() && content[0] == '/' && !openElements.empty() &&
+                content.compare(1, string::npos, openElements.back()) == 0)
+            {
+                putVarint(structure, XML_TOKEN_CLOSE);
+                openElements.pop_back();
+            }
+            else if (content.empty() || content[0] == '/' || content[0] == '?' ||
+                     content[0] == '!' || content.back() == '/')
+            {
+                putVarint(structure, XML_TOKEN_RAW + 2 * tagId(content));
+            }
+            else
+            {
+                putVarint(structure, XML_TOKEN_OPEN + 2 * tagId(content));
+                openElements.push_back(extract_tag_name(content));
+            }
+            continue;
+        }
+
+        // Text runs up to the next '<' (a '<' without '>' is just text)
+        size_t next = xml.find('<', xml[i] == '<' ? i + 1 : i);
+        if (next == string::npos)
+            next = n;
+
+        bool blank = true;
+        for (size_t k = i; k < next && blank; ++k)
+            blank = isspace((unsigned char)xml[k]);
+
+        if (blank)
+        {
+            putVarint(structure, XML_TOKEN_SPACE);
+            texts["#ws"].append(xml, i, next - i);
+            texts["#ws"] += '\0';
+        }
+        else
+        {
+            string &container = texts[textContainerName(openElements)];
+            putVarint(structure, XML_TOKEN_TEXT);
+            container.append(xml, i, next - i);
+            container += '\0';
+        }
+        i = next;
+    }
+
+    texts["#structure"] = move(structure);
+    texts["#tags"] = move(tagTable);
+
+    // Containers are independent, so they are compressed in parallel
+    vector<XmlContainer> containers;
+    vector<const string *> raws;
+    for (const auto &[name, raw] : texts)
+    {
+        containers.push_back({name, CONTAINER_RAW, 0, ""});
+        raws.push_back(&raw);
+    }
+
+    parallelFor(containers.size(), threads, [&](size_t begin, size_t end, int)
+    {
+        for (size_t c = begin; c < end; ++c)
+            encodeContainer(containers[c], *raws[c]);
+    });
+
+    string result(XML_CODEC_MAGIC, 4);
+    result += (char)XML_CODEC_VERSION;
+    result += string(3, '\0');
+    putU64(result, xml.size());
+    putU32(result, (uint32_t)containers.size());
+
+    for (const auto &container : containers)
+    {
+        putU32(result, (uint32_t)container.name.size());
+        result += container.name;
+        result += (char)container.method;
+        putU64(result, container.rawSize);
+        putU64(result, container.payload.size());
+    }
+    for (const auto &container : containers)
+        result += container.payload;
+
+    return result;
+}
+
+// ==================== Decoding ====================
+
+bool parseStructuralContainers(const unsigned char *bytes, size_t size, vector<XmlContainer> &containers)
+{
+    const unsigned char *p = bytes;
+    const unsigned char *end = p + size;
+    if (size < 20 || memcmp(p, XML_CODEC_MAGIC, 4) != 0 || p[4] != XML_CODEC_VERSION)
+    {
+        cerr << "Error: Unsupported structural stream version" << endl;
+        return false;
+    }
+
+    uint32_t count = getU32(p + 16);
+    p += 20;
+
+    vector<uint64_t> storedSize;
+    containers.clear();
+    for (uint32_t c = 0; c < count; ++c)
+    {
+        if (end - p < 4 || (uint64_t)(end - p - 4) < getU32(p) + 17ull)
+        {
+            cerr << "Error: Corrupt container directory" << endl;
+            return false;
+        }
+
+        XmlContainer container;
+        uint32_t nameLength = getU32(p);
+        container.name.assign((const char *)p + 4, nameLength);
+        p += 4 + nameLength;
+        container.method = *p;
+        container.rawSize = getU64(p + 1);
+        storedSize.push_back(getU64(p + 9));
+        p += 17;
+        containers.push_back(move(container));
+    }
+
+    for (uint32_t c = 0; c < count; ++c)
+    {
+        if ((uint64_t)(end - p) < storedSize[c])
+        {
+            cerr << "Error: Container " << containers[c].name << " is cut off" << endl;
+            return false;
+        }
+        containers[c].payload.assign((const char *)p, storedSize[c]);
+        p += storedSize[c];
+    }
+
+    return true;
+}
+
+bool parseStructuralContainers(const string &comp, vector<XmlContainer> &containers)
+{
+    return parseStructuralContainers((const unsigned char *)comp.data(), comp.size(), containers);
+}
+
+// Hands out the NUL-terminated strings of one container in order
+struct ContainerCursor
+{
+    size_t position = 0;
+
+    bool next(string &out, const string &text)
+    {
+        size_t terminator = text.find('\0', position);
+        if (terminator == string::npos)
+            return false;
+        out.append(text, position, terminator - position);
+        position = terminator + 1;
+        return true;
+    }
+};
+
+bool decompressStructural(const unsigned char *bytes, size_t size, string &xml, int threads)
+{
+    vector<XmlContainer> containers;
+    if (!parseStructuralContainers(bytes, size, containers))
+        return false;
+
+    vector<string> raws(containers.size());
+    vector<char> ok(containers.size(), 0);
+    parallelFor(containers.size(), threads, [&](size_t begin, size_t end, int)
+    {
+        for (size_t c = begin; c < end; ++c)
+            ok[c] = decodeContainer(containers[c], raws[c]);
+    });
+
+    unordered_map<string, size_t> byName;
+    for (size_t c = 0; c < containers.size(); ++c)
+    {
+        if (!ok[c])
+            return false;
+        byName[containers[c].name] = c;
+    }
+
+    if (!byName.count("#structure") || !byName.count("#tags"))
+    {
+        cerr << "Error: Structural stream has no structure or tag container" << endl;
+        return false;
+    }
+
+    // Tag table
+    vector<string> tags;
+    const string &tagTable = raws[byName["#tags"]];
+    for (size_t start = 0; start < tagTable.size();)
+    {
+        size_t terminator = tagTable.find('\0', start);
+        if (terminator == string::npos)
+            break;
+        tags.push_back(tagTable.substr(start, terminator - start));
+        start = terminator + 1;
+    }
+
+    // Replay the structure tokens
+    const string &structure = raws[byName["#structure"]];
+    const unsigned char *p = (const unsigned char *)structure.data();
+    const unsigned char *end = p + structure.size();
+
+    vector<ContainerCursor> cursors(containers.size());
+    vector<string> openElements;
+    xml.clear();
+
+    auto nextText = [&](const string &name)
+    {
+        auto found = byName.find(name);
+        if (found == byName.end() || !cursors[found->second].next(xml, raws[found->second]))
+        {
+            cerr << "Error: Container " << name << " ran out of text" << endl;
+            return false;
+        }
+        return true;
+    };
+
+    while (p < end)
+    {
+        uint64_t token;
+        if (!getVarint(p, end, token))
+        {
+            cerr << "Error: Corrupt structure stream" << endl;
+            return false;
+        }
+
+        if (token == XML_TOKEN_CLOSE)
+        {
+            if (openElements.empty())
+            {
+                cerr << "Error: Structure stream closes more elements than it opens" << endl;
+                return false;
+            }
+            xml += "</" + openElements.back() + ">";
+            openElements.pop_back();
+        }
+        else if (token == XML_TOKEN_TEXT)
+        {
+            if (!nextText(textContainerName(openElements)))
+                return false;
+        }
+        else if (token == XML_TOKEN_SPACE)
+        {
+            if (!nextText("#ws"))
+                return false;
+        }
+        else
+        {
+            uint64_t id = (token - XML_TOKEN_OPEN) / 2;
+            if (id >= tags.size())
+            {
+                cerr << "Error: Unknown tag id " << id << endl;
+                return false;
+            }
+            xml += "<" + tags[id] + ">";
+            if ((token - XML_TOKEN_OPEN) % 2 == 0)
+                openElements.push_back(extract_tag_name(tags[id]));
+        }
+    }
+
+    return true;
+}
+
+bool decompressStructural(const string &comp, string &xml, int threads)
+{
+    return decompressStructural((const unsigned char *)comp.data(), comp.size(), xml, threads);
+}
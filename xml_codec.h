@@ -0,0 +1,69 @@
+#ifndef XML_CODEC_H
+#define XML_CODEC_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+using namespace std;
+
+// Structural codec (.comp files starting with "XMLS"), XMill-style.
+// The document is split into separate containers that are compressed on their own:
+//   #structure : one varint token per tag or text run (see XML_TOKEN_*)
+//   #tags      : the distinct tag contents, NUL-separated, indexed by the tokens
+//   #ws        : whitespace-only text runs, NUL-separated
+//   <p>/<name> : text runs of element <name> inside element <p> (user/id, follower/id,
+//                post/body...)
+//
+// Layout (all fields little-endian):
+//   "XMLS", u8 version, 3 reserved bytes, u64 original size, u32 container count,
+//   per container: u32 name length, name, u8 method, u64 raw size, u64 stored size,
+//   then the stored container payloads in the same order.
+const char XML_CODEC_MAGIC[4] = {'X', 'M', 'L', 'S'};
+const unsigned char XML_CODEC_VERSION = 2;
+
+// Structure tokens; tag tokens carry their #tags index
+const uint64_t XML_TOKEN_CLOSE = 0; // closes the innermost open element
+const uint64_t XML_TOKEN_TEXT = 1;  // next string of the parent element's container
+const uint64_t XML_TOKEN_SPACE = 2; // next string of #ws
+const uint64_t XML_TOKEN_OPEN = 3;  // 3 + 2 * id: opening tag, pushed on the element stack
+const uint64_t XML_TOKEN_RAW = 4;   // 4 + 2 * id: any other markup written back verbatim
+
+// How a container's payload is stored
+const unsigned char CONTAINER_RAW = 0;
+const unsigned char CONTAINER_BPE = 1; // byte or wide BPE stream
+// Containers holding only decimal integers (ids): each value minus the previous one,
+// zigzag-mapped and written as a varint, then BPE-coded when that list is large
+const unsigned char CONTAINER_DELTA = 2;
+const unsigned char CONTAINER_DELTA_BPE = 3;
+
+// Each container is coded once, by a method picked from its size and content:
+// text below this size uses byte BPE, larger text the wide symbol table
+const size_t XML_WIDE_CONTAINER = 256 << 10;
+
+// Below this size compress -m xml also tries plain BPE: the container directory
+// costs more than the split saves on a small document
+const size_t XML_CODEC_MIN_INPUT = 64 << 10;
+
+// Container of text runs that are not inside any element
+const string XML_ROOT_CONTAINER = "#root";
+
+struct XmlContainer
+{
+    string name;
+    unsigned char method;
+    uint64_t rawSize;
+    string payload;
+};
+
+// Empty result when the document cannot be split (it contains NUL bytes)
+string compressStructural(const string &xml, int threads);
+bool decompressStructural(const unsigned char *bytes, size_t size, string &xml, int threads);
+bool decompressStructural(const string &comp, string &xml, int threads);
+
+// Reads the container directory and payloads without decoding them
+bool parseStructuralContainers(const unsigned char *bytes, size_t size, vector<XmlContainer> &containers);
+bool parseStructuralContainers(const string &comp, vector<XmlContainer> &containers);
+bool decodeContainer(const XmlContainer &container, string &raw);
+
+#endif
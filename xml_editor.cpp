@@ -1,6 +1,14 @@
 #include "functions.h"
 #include "utils.h"
 #include "graph.h"
+#include "compression.h"
+#include "archive.h"
+#include "compressed_search.h"
+#include "dictionary.h"
+#include "centrality.h"
+#include "social_index.h"
+#include "compact_graph.h"
+#include "server.h"
 
 int main(int argc, char* argv[]) {
     string input_path;
@@ -15,6 +23,21 @@ int main(int argc, char* argv[]) {
     vector<int> Ids;
     string strIDs;
     string verify_result;
+    int threads = 1;
+    string mode = "bpe";
+    int level = 1;
+    bool train = false;
+    size_t topK = 0;
+    bool allUsers = false;
+    bool compact = false;
+    size_t limit = 0;
+    string weighting = "common";
+    string direction = "following";
+    string socket_path = SERVER_DEFAULT_SOCKET;
+    string delta_path;
+    PageRankOptions rankOptions;
+    int iterations = 0;
+    string dictionary_path;
 
     // Parse command line arguments
     for (int i = 1; i < argc; ++i) {
@@ -32,6 +55,67 @@ int main(int argc, char* argv[]) {
             userId = stoi(argv[i + 1]);
             i++;
         }
+        else if (arg == "-j" && i + 1 < argc) {
+            threads = stoi(argv[i + 1]);   // 0 => all cores
+            i++;
+        }
+        else if (arg == "-m" && i + 1 < argc) {
+            mode = argv[i + 1];
+            i++;
+        }
+        else if (arg == "-l" && i + 1 < argc) {
+            level = stoi(argv[i + 1]);   // 2 => add the entropy stage
+            i++;
+        }
+        else if (arg == "-d" && i + 1 < argc) {
+            dictionary_path = argv[i + 1];
+            i++;
+        }
+        else if (arg == "--top" && i + 1 < argc) {
+            topK = stoul(argv[i + 1]);   // most_active / most_influencer: rank the best K users
+            i++;
+        }
+        else if (arg == "-k" && i + 1 < argc) {
+            limit = stoul(argv[i + 1]);   // suggest: keep the best K
+            i++;
+        }
+        else if (arg == "--score" && i + 1 < argc) {
+            weighting = argv[i + 1];   // suggest: common, adamic-adar or jaccard
+            i++;
+        }
+        else if (arg == "--dir" && i + 1 < argc) {
+            direction = argv[i + 1];   // path: following, followers or any
+            i++;
+        }
+        else if (arg == "--delta" && i + 1 < argc) {
+            delta_path = argv[i + 1];   // apply-delta
+            i++;
+        }
+        else if (arg == "--socket" && i + 1 < argc) {
+            socket_path = argv[i + 1];   // serve
+            i++;
+        }
+        else if (arg == "--damping" && i + 1 < argc) {
+            rankOptions.damping = stod(argv[i + 1]);   // pagerank
+            i++;
+        }
+        else if (arg == "--tol" && i + 1 < argc) {
+            rankOptions.tolerance = stod(argv[i + 1]);   // pagerank
+            i++;
+        }
+        else if (arg == "--iters" && i + 1 < argc) {
+            iterations = stoi(argv[i + 1]);   // pagerank / communities: round limit
+            i++;
+        }
+        else if (arg == "--all") {
+            allUsers = true;   // suggest for every user
+        }
+        else if (arg == "--compact") {
+            compact = true;   // suggest / mutual / pagerank over varint-coded lists; snapshot: store them too
+        }
+        else if (arg == "--train") {
+            train = true;   // compress --train: learn a shared dictionary from -i
+        }
         else if (arg == "-f") {
             fix = true;
         }
@@ -71,11 +155,52 @@ int main(int argc, char* argv[]) {
             cout << "Without Fixation" << endl;
     }
     
+    // Shared dictionary: written by compress --train, loaded with -d
+    if (!dictionary_path.empty() && !loadSharedDictionary(dictionary_path)) {
+        return 1;
+    }
+
+    if (operation == "compress" && train) {
+        vector<string> samples;
+        if (!readTrainingSamples(input_path, samples)) {
+            return 1;
+        }
+        if (writeBinaryToFile(output_path, trainSharedDictionary(samples))) {
+            cout << "File created successfully!\n";
+        } else {
+            cout << "Failed to create file.\n";
+        }
+        return 0;
+    }
+
     cout << "Attempting to read XML file: " << input_path << endl;
 
+    // Archives are never loaded whole: only their index and the blocks a query needs are read
+    ArchiveReader archive;
+    bool fromArchive = (operation == "extract" || operation == "suggest" || operation == "mutual") &&
+                       isArchiveFile(input_path);
+
+    // Compressed input is searched without decompressing it first
+    bool fromCompressed = operation == "search" && isCompressedFile(input_path);
+
+    // Graph snapshots are mapped instead of parsed; the analytics use the stored index
+    SocialIndex snapshot;
+    const vector<string> snapshotOperations = {"most_active", "most_influencer", "pagerank", "components",
+                                               "communities", "triangles", "mutual", "path", "suggest", "search", "serve",
+                                               "apply-delta", "draw"};
+    bool fromSnapshot = !fromArchive && !fromCompressed &&
+                        find(snapshotOperations.begin(), snapshotOperations.end(), operation) != snapshotOperations.end() &&
+                        isSnapshotFile(input_path);
+
     // Read input file (binary for decompress, text for everything else)
     bool extractSuccess;
-    if (operation == "decompress") {
+    if (fromArchive) {
+        extractSuccess = archive.open(input_path);
+    }
+    else if (fromSnapshot) {
+        extractSuccess = snapshot.open(input_path);
+    }
+    else if (operation == "decompress" || fromCompressed) {
         extractSuccess = extract_binary_content(input_path, xml_content);
     } else {
         extractSuccess = extract_content(input_path, xml_content);
@@ -87,8 +212,34 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
+    // --compact: the follower lists are varint-coded once, or read as the snapshot
+    // stores them, and the plain arrays are never laid out or are released
+    SocialIndex compactIndex;
+    CompactGraph compactGraph;
+    bool useCompact = compact && !fromArchive &&
+                      (operation == "suggest" || operation == "mutual" || operation == "pagerank");
+    if (useCompact) {
+        if (!fromSnapshot) {
+            if (!compactIndex.buildCoded(xml_content, threads)) {
+                return 1;
+            }
+            string().swap(xml_content);
+        }
+        SocialIndex &index = fromSnapshot ? snapshot : compactIndex;
+        size_t plainBytes = index.adjacencyBytes();
+        if (!compactGraph.build(index, threads)) {
+            return 1;
+        }
+        cout << "Compact adjacency: " << compactGraph.memoryBytes() << " bytes";
+        if (plainBytes > 0) {
+            cout << " (" << plainBytes << " as arrays)";
+        }
+        cout << "." << endl;
+    }
+
     // Process based on operation
     string updated_xml;
+    string summary; // one-line statistics of pagerank, communities and path
     if(operation == "verify") {
         updated_xml = verify(xml_content);
         if (fix) {
@@ -105,10 +256,44 @@ int main(int argc, char* argv[]) {
         updated_xml = mini(xml_content);
     }
     else if(operation == "compress") {
-        updated_xml = compress(xml_content);
+        updated_xml = compress(xml_content, mode, threads, level);
+        if (updated_xml.empty()) {
+            return 1;
+        }
+    }
+    else if(operation == "archive") {
+        updated_xml = buildArchive(xml_content);
     }
-    else if(operation == "decompress") {
+    else if(operation == "extract") {
+        if (!fromArchive) {
+            cerr << "Error: extract needs an archive built with the archive operation." << endl;
+            return 1;
+        }
+        if (userId == -1) {
+            cerr << "Error: User ID (-id) is required for extract operation." << endl;
+            return 1;
+        }
+        if (!archive.extractUser(userId, updated_xml)) {
+            cerr << "Error: User " << userId << " is not in the archive." << endl;
+            return 1;
+        }
+    }
+    else if(operation == "decompress" && threads == 1) {
         updated_xml = decompress(xml_content);
+        if (updated_xml.empty()) {
+            return 1;
+        }
+    }
+    else if (operation == "suggest" && (allUsers || !strIDs.empty())) {
+        // Batch mode: one line per user, the graph is built once
+        if (fromArchive) {
+            cerr << "Error: Batch suggest needs the XML document; decompress the archive first." << endl;
+            return 1;
+        }
+        Ids = allUsers ? vector<int>() : strIDs2int(strIDs);
+        updated_xml = useCompact     ? suggestBatch(compactGraph, Ids, threads, limit, weighting)
+                      : fromSnapshot ? suggestBatch(snapshot, Ids, threads, limit, weighting)
+                                     : suggestBatch(xml_content, Ids, threads, limit, weighting);
     }
     else if (operation == "suggest"){
         if (userId == -1)
@@ -116,17 +301,28 @@ int main(int argc, char* argv[]) {
             cerr << "Error: User ID (-id) is required for suggest operation." << endl;
             return 1;
         }
-        updated_xml = suggest(xml_content, userId);
+        if (fromArchive) {
+            xml_content = archive.suggestDocument(userId);
+        }
+        updated_xml = useCompact     ? suggest(compactGraph, userId, limit, weighting)
+                      : fromSnapshot ? suggest(snapshot, userId, limit, weighting)
+                                     : suggest(xml_content, userId, limit, weighting);
         // cout << "Suggested users for User " << userId << ":" << endl;
         // cout << updated_xml;
     }
     else if (operation == "search")
     {
-        if (isWord == false) {
-            s_posts = searchPostsByTopic(xml_content, post_seach);
+        if (fromCompressed) {
+            if (!searchCompressedPosts(xml_content, post_seach, isWord, s_posts)) {
+                cerr << "Error: Could not search the compressed file." << endl;
+                return 1;
+            }
+        }
+        else if (isWord == false) {
+            s_posts = fromSnapshot ? searchPostsByTopic(snapshot, post_seach) : searchPostsByTopic(xml_content, post_seach);
         }
         else {
-            s_posts = searchPostsByWord(xml_content, post_seach);
+            s_posts = fromSnapshot ? searchPostsByWord(snapshot, post_seach) : searchPostsByWord(xml_content, post_seach);
         }
 
         for (auto& post : s_posts) {
@@ -134,29 +330,125 @@ int main(int argc, char* argv[]) {
             updated_xml += "\n";
         }
     }
+    else if (operation == "serve")
+    {
+        // Resident mode: the index is built (or mapped) once and every request reuses it
+        SocialIndex built;
+        if (!fromSnapshot) {
+            if (!built.build(xml_content)) {
+                return 1;
+            }
+            string().swap(xml_content);   // the index keeps its own copy of the text
+        }
+        return serveRequests(fromSnapshot ? snapshot : built, socket_path, threads) ? 0 : 1;
+    }
+    else if (operation == "apply-delta")
+    {
+        // Patches the index of -i and writes it as a snapshot, without reparsing the document
+        string delta;
+        if (delta_path.empty() || !extract_content(delta_path, delta)) {
+            cerr << "Error: apply-delta needs a delta document (--delta)." << endl;
+            return 1;
+        }
+        SocialIndex built;
+        if (!fromSnapshot && !built.build(xml_content)) {
+            return 1;
+        }
+        SocialIndex &index = fromSnapshot ? snapshot : built;
+        DeltaSummary summary;
+        if (!index.applyDelta(delta, summary)) {
+            return 1;
+        }
+        cout << "Delta: +" << summary.usersAdded << " / -" << summary.usersRemoved << " users, +"
+             << summary.followsAdded << " / -" << summary.followsRemoved << " follows, +"
+             << summary.postsAdded << " / -" << summary.postsRemoved << " posts." << endl;
+        updated_xml = index.serialize();
+        if (updated_xml.empty()) {
+            return 1;
+        }
+    }
+    else if (operation == "snapshot")
+    {
+        SocialIndex index;
+        if (!index.build(xml_content)) {
+            return 1;
+        }
+        // --compact stores the coded lists too, so --compact runs map them directly
+        if (compact && !index.codeLists(threads)) {
+            return 1;
+        }
+        updated_xml = index.serialize();
+    }
     else if (operation == "most_active")
     {
-        updated_xml = most_active(xml_content);
+        updated_xml = fromSnapshot ? most_active(snapshot, topK) : most_active(xml_content, topK);
     }
     else if (operation == "most_influencer")
     {
-        updated_xml = most_influencer(xml_content);
+        updated_xml = fromSnapshot ? most_influencer(snapshot, topK) : most_influencer(xml_content, topK);
+    }
+    else if (operation == "pagerank")
+    {
+        if (rankOptions.damping < 0 || rankOptions.damping >= 1) {
+            cerr << "Error: --damping must be in [0, 1)." << endl;
+            return 1;
+        }
+        if (iterations > 0)
+            rankOptions.maxIterations = iterations;
+        rankOptions.threads = threads;
+        updated_xml = useCompact     ? pagerank(compactGraph, rankOptions, topK, &summary)
+                      : fromSnapshot ? pagerank(snapshot, rankOptions, topK, &summary)
+                                     : pagerank(xml_content, rankOptions, topK, &summary);
+    }
+    else if (operation == "components")
+    {
+        updated_xml = fromSnapshot ? components(snapshot, threads) : components(xml_content, threads);
+    }
+    else if (operation == "triangles")
+    {
+        updated_xml = fromSnapshot ? triangles(snapshot, threads) : triangles(xml_content, threads);
+    }
+    else if (operation == "communities")
+    {
+        int rounds = iterations > 0 ? iterations : 20;
+        updated_xml = fromSnapshot ? communities(snapshot, rounds, threads, &summary)
+                                   : communities(xml_content, rounds, threads, &summary);
     }
     else if (operation == "mutual")
     {
         Ids = strIDs2int(strIDs);
-        updated_xml = mutual(xml_content, Ids);
+        if (fromArchive) {
+            xml_content = archive.usersDocument(Ids);
+        }
+        updated_xml = useCompact ? mutual(compactGraph, Ids) : fromSnapshot ? mutual(snapshot, Ids) : mutual(xml_content, Ids);
+    }
+    else if (operation == "path")
+    {
+        Ids = strIDs2int(strIDs);
+        updated_xml = fromSnapshot ? shortest_path(snapshot, Ids, direction, &summary)
+                                   : shortest_path(xml_content, Ids, direction, &summary);
     }
+
+    // Run statistics of the graph analytics go to the console, not the output file
+    if (!summary.empty())
+        cout << summary << endl;
     
     
 
     // Write output file (binary for compress, text for everything else)
     bool writeSuccess;
-    if (operation == "compress") {
+    if (operation == "compress" || operation == "archive" || operation == "snapshot" || operation == "apply-delta") {
         writeSuccess = writeBinaryToFile(output_path, updated_xml);
     } 
+    else if (operation == "decompress" && threads != 1) {
+        // Multithreaded mode expands straight into the output file
+        writeSuccess = decompressToFile(xml_content, output_path, threads);
+    }
     else if (operation == "draw") {
-        drawXMLGraph(xml_content, output_path);
+        if (fromSnapshot)
+            drawIndexGraph(snapshot, output_path);
+        else
+            drawXMLGraph(xml_content, output_path);
         writeSuccess = true;
     }
     else {
@@ -167,6 +459,7 @@ int main(int argc, char* argv[]) {
         cout << "File created successfully!\n";
     } else {
         cout << "Failed to create file.\n";
+        return 1;
     }
     
     return 0;